@@ -0,0 +1,54 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Packed graphics: written by mkassets, unpacked into VRAM by load_asset()
+//
+// Each tile or sprite is split into cells - an 8x8 tile (16 words), or a
+// 16x16 part of a sprite (64 words) - in the order they go into VRAM.
+// Identical cells are only kept once (in assetcells[], at the offsets in
+// assetcelloff[]), and a pack is a list of cell #s.
+//
+// The VRAM image (vramimage[]) is a pack for each run of tiles or sprites
+// which follow each other in VRAM with no gap, along with where it goes.
+//
+// A cell is packed as a series of codes, each followed by its data:
+//   00nnnnnn              n+1 words of 0
+//   01nnnnnn lo hi        n+1 copies of one word
+//   10nnnnnn lo hi ...    n+1 words, as they are
+// Planar data is mostly runs - empty planes, and rows repeated down a
+// block - so nothing more than this is needed.
+//
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <stdint.h>
+
+#define ASSET_ZERO       0x00
+#define ASSET_RUN        0x40
+#define ASSET_WORDS      0x80
+#define ASSET_CODEMASK   0xC0
+#define ASSET_COUNTMASK  0x3F
+#define ASSET_MAXCOUNT   (ASSET_COUNTMASK + 1)
+
+#define ASSET_TILEWORDS  16
+#define ASSET_SPRWORDS   64
+
+typedef struct assetpacks
+{
+   uint16_t words;          // # of words, unpacked
+   uint16_t cellwords;      // ASSET_TILEWORDS or ASSET_SPRWORDS
+   uint16_t numcells;
+   const uint8_t *cells;    // cell #s, in order
+} assetpack;
+
+typedef struct vramranges
+{
+   uint16_t  addr;          // VRAM word address
+   assetpack pack;
+} vramrange;
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Autoplayer (see auto.h)
+//
+
+#include "game.h"
+#include "auto.h"
+
+#define BOARDROWS        (FIELDHEIGHT+FIELDHIDHT)
+#define TOPOUTSCORE      (-1000000)	// score of a placement which ends the game
+
+// Weights x100, after the well-known "aggregate height / lines / holes /
+// bumpiness" player (-0.51, 0.76, -0.36, -0.18)
+//
+autoweight autoweights = { 76, -51, -36, -18 };
+
+// Score the board which would be left by putting the piece (pm) at (x,y)
+//
+static int evaluate(const gamestate *gs, const piecemask *pm, int x, int y)
+{
+fieldrow board[BOARDROWS];
+int height[FIELDWIDTH];
+uint32_t row, covered, newcols;
+int i, j, dst;
+int lines = 0, holes = 0, aggheight = 0, bumpiness = 0;
+
+   // lay the piece down, and take out the completed lines
+   //
+   dst = BOARDROWS - 1;
+
+   for (i = BOARDROWS - 1; i >= 0; i--) {
+      row = gs->dispmask[i];
+      if ((i >= y) && (i < (y + 4)))
+         row |= ((fieldrow)pm->rowmask[i - y] << x);
+
+      if (row == FIELDFULLMASK) {
+         lines++;
+         continue;
+      }
+      board[dst--] = row;
+   }
+   while (dst >= 0)
+      board[dst--] = 0;
+
+   // from the top down: each column's height is set by its first filled
+   // square, and every empty square below one is a hole
+   //
+   for (j = 0; j < FIELDWIDTH; j++)
+      height[j] = 0;
+
+   covered = 0;
+
+   for (i = 0; i < BOARDROWS; i++) {
+      newcols = board[i] & ~covered;
+      if (newcols) {
+         for (j = 0; j < FIELDWIDTH; j++)
+            if (newcols & FIELDBIT(j))
+               height[j] = BOARDROWS - i;
+         covered |= newcols;
+      }
+      holes += popcount32(covered & ~board[i]);
+   }
+
+   for (j = 0; j < FIELDWIDTH; j++) {
+      aggheight += height[j];
+      if (j > 0)
+         bumpiness += (height[j] > height[j-1]) ? (height[j] - height[j-1]) : (height[j-1] - height[j]);
+   }
+
+   return((autoweights.lines * lines) +
+          (autoweights.height * aggheight) +
+          (autoweights.holes * holes) +
+          (autoweights.bumpiness * bumpiness));
+}
+
+// Find the best place for the game's current piece
+//
+void auto_plan(const gamestate *gs, autoplan *plan)
+{
+const piecemask *pm;
+const piecemask *seen[NUMPHASES];
+int phase, x, y, dir, score;
+int rotx, roty;
+int k, dup;
+
+   plan->phase     = -1;
+   plan->x         = gs->pieceposx;
+   plan->score     = TOPOUTSCORE - 1;
+   plan->evaluated = 0;
+   plan->lastpad   = 0;
+
+   phase = gs->phasenum;
+   rotx  = gs->pieceposx;
+   roty  = gs->pieceposy;
+
+   for (k = 0; k < NUMPHASES; k++) {
+
+      if (k > 0) {      // rotate once more from where the last one ended up
+         phase = rotate_to(gs, gs->piecenum, phase, ROT_NEXT, &rotx, &roty);
+         if (phase < 0)
+            break;      // can't get to this phase (or any after it)
+      }
+      pm = &piecemasktbl[PIECEIDX(gs->piecenum, phase)];
+
+      // a phase with the same shape as one already tried lands the same way
+      //
+      seen[k] = pm;
+      for (dup = 0; dup < k; dup++)
+         if ((seen[dup]->rowmask[0] == pm->rowmask[0]) && (seen[dup]->rowmask[1] == pm->rowmask[1]) &&
+             (seen[dup]->rowmask[2] == pm->rowmask[2]) && (seen[dup]->rowmask[3] == pm->rowmask[3]))
+            break;
+      if (dup < k)
+         continue;
+
+      // slide left, then right, from the rotated position
+      //
+      for (dir = -1; dir <= 1; dir += 2) {
+         x = (dir < 0) ? rotx : (rotx + 1);
+
+         if (dir > 0) {
+            if (chkmvok(gs, gs->piecenum, phase, rotx, roty, 1, 0) != 0)
+               continue;
+         }
+
+         while (1) {
+            y = landing_row(gs, gs->piecenum, phase, x, roty);
+
+            if (y < FIELDHIDHT)
+               score = TOPOUTSCORE;
+            else
+               score = evaluate(gs, pm, x, y);
+            plan->evaluated++;
+
+            if (score > plan->score) {
+               plan->score = score;
+               plan->phase = phase;
+               plan->x     = x;
+            }
+
+            if (chkmvok(gs, gs->piecenum, phase, x, roty, dir, 0) != 0)
+               break;
+            x += dir;
+         }
+      }
+   }
+}
+
+// Joypad input for this frame: rotate, then move across, then drop.
+// Each is a tap (pressed, then released on the next frame), so that the
+// joypad auto-repeat never comes into it.
+//
+uint32_t auto_pad(const gamestate *gs, autoplan *plan)
+{
+uint32_t pad;
+
+   if (plan->phase < 0)
+      pad = JOY_DOWN;
+   else if (gs->phasenum != plan->phase)
+      pad = JOY_I;
+   else if (gs->pieceposx > plan->x)
+      pad = JOY_LEFT;
+   else if (gs->pieceposx < plan->x)
+      pad = JOY_RIGHT;
+   else
+      pad = JOY_DOWN;
+
+   if (pad == plan->lastpad)   // release, so that the next one is a press
+      pad = 0;
+   plan->lastpad = pad;
+
+   return(pad);
+}
@@ -0,0 +1,52 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Autoplayer
+//
+// auto_plan() looks at every landing position the current piece can reach
+// (rotating with button I from where it appeared, then moving sideways,
+// then dropping), scores the board each one would leave, and picks the
+// best.  auto_pad() then gives the joypad input which steers the piece
+// there, one frame at a time - so the autoplayer plays through
+// game_frame() exactly like a person would.
+//
+// Boards are scored as a weighted sum (higher is better):
+//   lines     - # of lines the placement completes
+//   height    - sum of the column heights
+//   holes     - empty squares with a filled square somewhere above them
+//   bumpiness - sum of the height differences between adjacent columns
+//
+
+#ifndef AUTO_H
+#define AUTO_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+typedef struct autoweights
+{
+   int      lines;
+   int      height;
+   int      holes;
+   int      bumpiness;
+} autoweight;
+
+typedef struct autoplans
+{
+   int      phase;      // where to put the piece (phase < 0 if nowhere)
+   int      x;
+   int      score;
+   int      evaluated;  // # of placements looked at
+   uint32_t lastpad;    // auto_pad()'s last result
+} autoplan;
+
+extern autoweight autoweights;
+
+void     auto_plan(const gamestate *gs, autoplan *plan);
+uint32_t auto_pad(const gamestate *gs, autoplan *plan);
+
+#endif
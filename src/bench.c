@@ -0,0 +1,459 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// bench - run the game rules on the host, with scripted or recorded input
+//
+// usage:
+//   blox-bench [-a] [-k] [-W lines,height,holes,bumpiness] [-s seed] [-w recfile] [frames]
+//   blox-bench [-k] -r recfile
+//   blox-bench -2 [-k] [-W lines,height,holes,bumpiness] [-s seed] [frames]
+//
+// Plays the given number of frames (default 10000000), starting a new game
+// whenever one ends, and reports frames/second and pieces/second.  Game n
+// (from 0) of the run is started with seed (seed + n); seed defaults to 1.
+//
+// The input script is fixed: for each new piece, a rotation and a column
+// are picked from a simple LCG; the script then taps rotate and left/right
+// (on alternate frames, so that every tap is a new press) until the piece
+// gets there, and then taps down until the piece comes to rest.  The same
+// number of frames always plays out the same way.
+//
+// -a plays with the autoplayer (auto.h) instead of the script, and also
+// reports how many placements it evaluated per second of searching;
+// -W sets the autoplayer's weights.
+//
+// -k plays with wall kicks (ROT_KICKS, see game.h) instead of classic
+// rotation.  The recording doesn't say which was used, so a recording
+// made with -k has to be played back with -k.
+//
+// -w records the input to recfile (see replay.h), along with a checksum
+// of the state at the end of each game and at the end of the run; -r plays
+// a recording back instead of the script, and checks the checksum.
+//
+// Recording file: "BLXR", then # of frames, checksum, # of data bytes and
+// seed (32 bits each, LSB first), then the data.
+//
+// Also reported: the # of playfield words that dirty-row redrawing would
+// have written, compared with redrawing the whole visible field each frame.
+//
+// -2 plays versus matches (versus.h) between two autoplayers, at the top
+// speed in diff_level (player 2 plays with the -W weights, or by default
+// minds holes less, so that the two differ); it reports the most VRAM words any one frame
+// would queue for the two fields, their scores and the page flips - in
+// particular in frames where both players cleared lines - against the
+// worst case of both fields being redrawn completely (which blox.c checks
+// fits in the vblank budget).  Each field is double-buffered, so the page
+// drawn in a frame takes the rows changed in that frame and the last.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "hosttest.h"
+#include "replay.h"
+#include "auto.h"
+#include "versus.h"
+
+#define BENCHFRAMES      10000000
+#define RECHDRSIZE       20
+#define SCOREDIGITS      5	// (as in blox.c)
+#define VISIBLEROWS      (ALLROWS & ~((1 << FIELDHIDHT) - 1))
+
+static uint32_t scriptstate = 1;
+
+static int targetphase, targetx;
+static uint32_t lastpad;
+
+// (not hosttest.h's lcg_next(): the checksums depend on this sequence)
+//
+static int script_next(int range)
+{
+   scriptstate = (scriptstate * 1103515245) + 12345;
+   return((scriptstate >> 16) % range);
+}
+
+static void script_newpiece(void)
+{
+   targetphase = script_next(4);
+   targetx     = script_next(FIELDWIDTH);
+}
+
+static uint32_t script_pad(const gamestate *gs)
+{
+uint32_t pad;
+
+   if (gs->phasenum != targetphase)
+      pad = JOY_I;
+   else if (gs->pieceposx > targetx)
+      pad = JOY_LEFT;
+   else if ((gs->pieceposx < targetx) &&
+            (chkmvok(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy, 1, 0) == 0))
+      pad = JOY_RIGHT;
+   else
+      pad = JOY_DOWN;
+
+   if (pad == lastpad)      // release, so that the next one is a press
+      pad = 0;
+   lastpad = pad;
+
+   return(pad);
+}
+
+static void put32(uint8_t *out, uint32_t val)
+{
+   out[0] = val;
+   out[1] = val >> 8;
+   out[2] = val >> 16;
+   out[3] = val >> 24;
+}
+
+static uint32_t get32(const uint8_t *in)
+{
+   return(in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24));
+}
+
+static int save_recording(const char *filename, const inputrec *rec, uint32_t checksum)
+{
+uint8_t hdr[RECHDRSIZE];
+FILE *outfile;
+
+   memcpy(hdr, "BLXR", 4);
+   put32(hdr + 4, rec->frames);
+   put32(hdr + 8, checksum);
+   put32(hdr + 12, rec->len);
+   put32(hdr + 16, rec->seed);
+
+   outfile = fopen(filename, "wb");
+   if (outfile == NULL) {
+      fprintf(stderr, "blox-bench: cannot create %s\n", filename);
+      return(0);
+   }
+   fwrite(hdr, 1, RECHDRSIZE, outfile);
+   fwrite(rec->buf, 1, rec->len, outfile);
+   fclose(outfile);
+   return(1);
+}
+
+static uint8_t *load_recording(const char *filename, long *frames, uint32_t *checksum, int *len,
+                               uint32_t *seed)
+{
+uint8_t hdr[RECHDRSIZE];
+uint8_t *buf;
+FILE *infile;
+
+   infile = fopen(filename, "rb");
+   if (infile == NULL) {
+      fprintf(stderr, "blox-bench: cannot open %s\n", filename);
+      return(NULL);
+   }
+
+   if ((fread(hdr, 1, RECHDRSIZE, infile) != RECHDRSIZE) || (memcmp(hdr, "BLXR", 4) != 0)) {
+      fprintf(stderr, "blox-bench: %s is not a recording\n", filename);
+      fclose(infile);
+      return(NULL);
+   }
+
+   *frames   = get32(hdr + 4);
+   *checksum = get32(hdr + 8);
+   *len      = get32(hdr + 12);
+   *seed     = get32(hdr + 16);
+
+   buf = malloc(*len + 1);
+   if ((buf == NULL) || (fread(buf, 1, *len, infile) != (size_t)*len)) {
+      fprintf(stderr, "blox-bench: %s is truncated\n", filename);
+      fclose(infile);
+      free(buf);
+      return(NULL);
+   }
+
+   fclose(infile);
+   return(buf);
+}
+
+// Versus matches; the VRAM words each frame would queue (see above)
+//
+static void run_versus(long frames, uint32_t seed, const autoweight *p2weights, int rotmode)
+{
+static vsmatch vs;
+gamestate *gs;
+autoweight weights[VS_PLAYERS];
+autoplan plan[VS_PLAYERS];
+uint32_t lastdirty[VS_PLAYERS];
+int lastscore[VS_PLAYERS], scorechanged[VS_PLAYERS];
+int events[VS_PLAYERS];
+long frame, matches = 0, wins[VS_PLAYERS + 1] = { 0 };
+long sent = 0, bothframes = 0, words, maxwords = 0, maxboth = 0, totalwords = 0;
+uint32_t pad;
+int p, over = 1, worst;
+double start, elapsed;
+
+   weights[0] = autoweights;
+   weights[1] = *p2weights;
+
+   for (p = 0; p < VS_PLAYERS; p++) {
+      game_set_levels(&vs.game[p], &diff_level[diff_numlevels - 1], 1);
+      game_set_rotation(&vs.game[p], rotmode);
+   }
+
+   start = now_sec();
+
+   for (frame = 0; frame < frames; frame++)
+   {
+      if (over) {
+         versus_start(&vs, seed + matches);
+         matches++;
+         for (p = 0; p < VS_PLAYERS; p++) {
+            autoweights = weights[p];
+            auto_plan(&vs.game[p], &plan[p]);
+            lastdirty[p]    = 0;
+            lastscore[p]    = 0;
+            scorechanged[p] = 0;
+         }
+      }
+
+      words = 2 * VS_PLAYERS;        // the page flip (scroll registers)
+
+      for (p = 0; p < VS_PLAYERS; p++) {
+         gs = &vs.game[p];
+
+         // (once the piece is in place, drop it: at top speed there is
+         // no time to tap down)
+         //
+         pad = auto_pad(gs, &plan[p]);
+         if (pad == JOY_DOWN)
+            pad = JOY_UP;
+
+         events[p] = versus_frame(&vs, p, pad);
+         if (events[p] & GAME_LOCKED) {
+            autoweights = weights[p];
+            auto_plan(gs, &plan[p]);
+         }
+
+         words += popcount32((gs->dirtyrows | lastdirty[p]) & VISIBLEROWS) * FIELDWIDTH;
+         lastdirty[p]  = gs->dirtyrows;
+         gs->dirtyrows = 0;
+
+         if ((gs->scoreval != lastscore[p]) || scorechanged[p])
+            words += SCOREDIGITS;
+         scorechanged[p] = (gs->scoreval != lastscore[p]);
+         lastscore[p]    = gs->scoreval;
+      }
+
+      totalwords += words;
+      maxwords = MAX(maxwords, words);
+
+      if ((events[0] & GAME_LINES) && (events[1] & GAME_LINES)) {
+         bothframes++;
+         maxboth = MAX(maxboth, words);
+      }
+
+      over = (events[0] | events[1]) & GAME_OVER;
+      if (over) {
+         if (events[0] & events[1] & GAME_OVER)
+            wins[2]++;                // (both topped out)
+         else
+            wins[(events[0] & GAME_OVER) ? 1 : 0]++;
+         sent += vs.sent[0] + vs.sent[1];
+      }
+   }
+
+   elapsed = now_sec() - start;
+   worst = (VS_PLAYERS * ((FIELDHEIGHT * FIELDWIDTH) + SCOREDIGITS)) + (2 * VS_PLAYERS);
+
+   printf("frames:        %ld\n", frame);
+   printf("matches:       %ld (player 1 won %ld, player 2 won %ld, drawn %ld)\n",
+          matches, wins[0], wins[1], wins[2]);
+   printf("garbage sent:  %ld lines\n", sent);
+   printf("elapsed:       %.3f sec\n", elapsed);
+   printf("frames/sec:    %.0f\n", frame / elapsed);
+   printf("VRAM words:    %.2f/frame on average, %ld at most\n", (double)totalwords / frame, maxwords);
+   printf("both cleared:  %ld frames, %ld words at most\n", bothframes, maxboth);
+   printf("worst case:    %d words (both fields redrawn, both scores, page flips)\n", worst);
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage:\n    blox-bench [-a] [-k] [-W lines,height,holes,bumpiness] [-s seed] [-w recfile] [frames]\n");
+   fprintf(stderr, "    blox-bench [-k] -r recfile\n");
+   fprintf(stderr, "    blox-bench -2 [-k] [-W lines,height,holes,bumpiness] [-s seed] [frames]\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+static gamestate game;
+long frames = BENCHFRAMES;
+long frame;
+long pieces = 0, lines = 0, games = 0;
+long dirtywords = 0;
+const char *recfile = NULL;
+const char *playfile = NULL;
+uint8_t *recbuf = NULL;
+uint8_t *playbuf = NULL;
+inputrec rec;
+inputplay play;
+long playframes = 0;
+uint32_t playchecksum = 0;
+int playlen;
+uint32_t seed = 1;
+uint32_t pad;
+uint32_t checksum = 0;
+int events, over, lastscore;
+double start, elapsed;
+int autoplay = 0;
+int versus = 0;
+int rotmode = ROT_CLASSIC;
+autoweight weights = autoweights;
+autoweight p2weights = { 76, -51, -10, -18 };
+autoplan plan;
+long placements = 0;
+double searchstart, searchtime = 0;
+int i;
+
+   for (i = 1; i < argc; i++) {
+      if ((strcmp(argv[i], "-w") == 0) && (i + 1 < argc))
+         recfile = argv[++i];
+      else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc))
+         playfile = argv[++i];
+      else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc))
+         seed = strtoul(argv[++i], NULL, 0);
+      else if (strcmp(argv[i], "-a") == 0)
+         autoplay = 1;
+      else if (strcmp(argv[i], "-2") == 0)
+         versus = 1;
+      else if (strcmp(argv[i], "-k") == 0)
+         rotmode = ROT_KICKS;
+      else if ((strcmp(argv[i], "-W") == 0) && (i + 1 < argc)) {
+         if (sscanf(argv[++i], "%d,%d,%d,%d", &weights.lines, &weights.height,
+                    &weights.holes, &weights.bumpiness) != 4)
+            usage();
+         p2weights = weights;
+      }
+      else if (argv[i][0] != '-')
+         frames = atol(argv[i]);
+      else
+         usage();
+   }
+   if ((recfile != NULL) && (playfile != NULL))
+      usage();
+   if (versus && (autoplay || (recfile != NULL) || (playfile != NULL)))
+      usage();
+
+   if (versus) {
+      run_versus(frames, seed, &p2weights, rotmode);
+      return(0);
+   }
+
+   autoweights = weights;
+   game_set_rotation(&game, rotmode);
+
+   if (playfile != NULL) {
+      playbuf = load_recording(playfile, &playframes, &playchecksum, &playlen, &seed);
+      if (playbuf == NULL)
+         return(1);
+      play_start(&play, playbuf, playlen);
+      frames = playframes;
+   }
+
+   if (recfile != NULL) {
+      recbuf = malloc(frames * REC_RUNBYTES);
+      rec_start(&rec, recbuf, frames * REC_RUNBYTES, seed);
+   }
+
+   start = now_sec();
+
+   over = 1;
+   events = 0;
+
+   for (frame = 0; frame < frames; frame++)
+   {
+      if (over) {
+         game_start(&game, seed + games);
+         games++;
+         script_newpiece();
+      }
+
+      if (autoplay && (over || (events & GAME_LOCKED))) {
+         searchstart = now_sec();
+         auto_plan(&game, &plan);
+         searchtime += now_sec() - searchstart;
+         placements += plan.evaluated;
+      }
+
+      if (playbuf != NULL) {
+         if (play_frame(&play, &pad) == 0)
+            break;
+      }
+      else if (autoplay) {
+         pad = auto_pad(&game, &plan);
+      }
+      else {
+         pad = script_pad(&game);
+      }
+
+      if (recbuf != NULL)
+         rec_frame(&rec, pad);
+
+      lastscore = game.scoreval;
+      events = game_frame(&game, pad);
+      lines += (game.scoreval - lastscore);     // score is in lines cleared
+
+      // what the display would have redrawn this frame
+      //
+      dirtywords += popcount32(game.dirtyrows & (ALLROWS & ~((1 << FIELDHIDHT) - 1))) * FIELDWIDTH;
+      game.dirtyrows = 0;
+
+      if (events & GAME_LOCKED) {
+         pieces++;
+         script_newpiece();
+      }
+
+      over = events & GAME_OVER;
+
+      if (over)
+         checksum = (checksum * 31) + game_checksum(&game);
+   }
+
+   elapsed = now_sec() - start;
+   if (!over)
+      checksum = (checksum * 31) + game_checksum(&game);
+
+   printf("frames:        %ld\n", frame);
+   printf("games:         %ld\n", games);
+   printf("pieces:        %ld\n", pieces);
+   printf("lines:         %ld\n", lines);
+   printf("elapsed:       %.3f sec\n", elapsed);
+   printf("frames/sec:    %.0f\n", frame / elapsed);
+   printf("pieces/sec:    %.0f\n", pieces / elapsed);
+   printf("field words:   %.2f/frame (dirty rows), %d/frame (full redraw)\n",
+          (double)dirtywords / frame, FIELDWIDTH * FIELDHEIGHT);
+   printf("checksum:      %08X\n", checksum);
+
+   if (autoplay) {
+      printf("placements:    %ld (%.1f/piece)\n", placements, (double)placements / (pieces + games));
+      printf("placements/sec: %.0f (search only)\n", placements / searchtime);
+   }
+
+   if (recbuf != NULL) {
+      rec_end(&rec);
+      printf("recording:     %d bytes, %.2f bytes/sec of play at 60 frames/sec\n",
+             rec.len, (rec.len * 60.0) / rec.frames);
+      if (save_recording(recfile, &rec, checksum) == 0)
+         return(1);
+   }
+
+   if (playbuf != NULL) {
+      if ((frame != playframes) || (checksum != playchecksum)) {
+         printf("replay:        MISMATCH (recorded %ld frames, checksum %08X)\n", playframes, playchecksum);
+         return(1);
+      }
+      printf("replay:        OK\n");
+   }
+
+   return(0);
+}
@@ -0,0 +1,211 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// A file of our own in backup memory (see bkupfs.h)
+//
+
+#include <string.h>
+
+#include "bkupfs.h"
+
+#define DIRENTSIZE       32
+#define ATTR_VOLUME      0x08	// volume label (set in long-name entries too)
+#define ATTR_ARCHIVE     0x20
+#define FAT12_CLUSTERS   4085	// (a volume with more clusters is FAT16)
+#define CLUSTER_END      0xFFF
+
+typedef struct volumes
+{
+   int      clussize;   // bytes per cluster
+   int      fatstart;   // address of the first FAT
+   int      fatsize;    // (bytes in each)
+   int      numfats;
+   int      dirstart;   // address of the root directory
+   int      direntries;
+   int      datastart;  // address of cluster 2, the first one
+   int      clusters;   // # of clusters (2 to clusters + 1)
+} volume;
+
+// the FAT, while bkupfs_open() is working on it
+//
+static uint8_t fat[BKUPFS_FATMAX];
+
+
+static int get16(const uint8_t *p)
+{
+   return(p[0] | (p[1] << 8));
+}
+
+static int fat_get(int n)
+{
+int val = get16(&fat[n + (n >> 1)]);
+
+   return((n & 1) ? (val >> 4) : (val & 0xFFF));
+}
+
+static void fat_set(int n, int val)
+{
+uint8_t *p = &fat[n + (n >> 1)];
+
+   if (n & 1) {
+      p[0] = (p[0] & 0x0F) | (val << 4);
+      p[1] = val >> 4;
+   }
+   else {
+      p[0] = val;
+      p[1] = (p[1] & 0xF0) | (val >> 8);
+   }
+}
+
+// Read the boot sector's parameters, and the FAT.  Returns 0 unless it is
+// a FAT12 volume which fits in backup memory, and whose FAT starts with
+// its media byte.  (Everything is in sectors until the volume is known to
+// fit, so nothing can overflow.)
+//
+static int read_volume(volume *v)
+{
+uint8_t boot[32];
+int secsize, spc, reserved, totalsecs, fatsecs, dirsecs, datasec;
+
+   bkupmem_read(0, boot, sizeof(boot));
+
+   secsize       = get16(&boot[0x0B]);
+   spc           = boot[0x0D];
+   reserved      = get16(&boot[0x0E]);
+   v->numfats    = boot[0x10];
+   v->direntries = get16(&boot[0x11]);
+   totalsecs     = get16(&boot[0x13]);
+   fatsecs       = get16(&boot[0x16]);
+
+   if ((secsize < DIRENTSIZE) || (secsize > BKUPFS_MEMSIZE) || ((secsize & (secsize - 1)) != 0) ||
+       (spc == 0) || (reserved == 0) || (v->numfats == 0) || (v->direntries == 0) ||
+       (fatsecs == 0) || (totalsecs > (BKUPFS_MEMSIZE / secsize)))
+      return(0);
+
+   dirsecs = ((v->direntries * DIRENTSIZE) + secsize - 1) / secsize;
+   datasec = reserved + (v->numfats * fatsecs) + dirsecs;
+   if (datasec >= totalsecs)
+      return(0);
+
+   v->clussize   = spc * secsize;
+   v->fatstart   = reserved * secsize;
+   v->fatsize    = fatsecs * secsize;
+   v->dirstart   = v->fatstart + (v->numfats * v->fatsize);
+   v->datastart  = datasec * secsize;
+   v->clusters   = (totalsecs - datasec) / spc;
+
+   if ((v->clusters == 0) || (v->clusters >= FAT12_CLUSTERS) || (v->fatsize > BKUPFS_FATMAX) ||
+       ((((v->clusters + 2) * 3) + 1) / 2 > v->fatsize))
+      return(0);
+
+   bkupmem_read(v->fatstart, fat, v->fatsize);
+
+   return((fat[0] == boot[0x15]) && (fat[1] == 0xFF));
+}
+
+// Look for name in the root directory (reading each entry into ent);
+// returns its entry #, or -1, with the first free entry in *freeent (or
+// -1 if there is none)
+//
+static int find_entry(const volume *v, const char *name, uint8_t *ent, int *freeent)
+{
+int i;
+
+   *freeent = -1;
+
+   for (i = 0; i < v->direntries; i++) {
+      bkupmem_read(v->dirstart + (i * DIRENTSIZE), ent, DIRENTSIZE);
+
+      if ((ent[0] == 0x00) || (ent[0] == 0xE5)) {
+         if (*freeent < 0)
+            *freeent = i;
+         if (ent[0] == 0x00)
+            break;              // (nothing is used after the first 0)
+         continue;
+      }
+      if ((ent[11] & ATTR_VOLUME) == 0) {
+         if (memcmp(ent, name, 11) == 0)
+            return(i);
+      }
+   }
+   return(-1);
+}
+
+int bkupfs_open(const char *name, int size)
+{
+static const uint8_t zeroes[DIRENTSIZE];
+volume v;
+uint8_t ent[DIRENTSIZE];
+int entry, freeent, count, first, n, i, lo, hi;
+
+   if (!read_volume(&v))
+      return(BKUPFS_NOFS);
+
+   count = (size + v.clussize - 1) / v.clussize;
+
+   entry = find_entry(&v, name, ent, &freeent);
+
+   // there already: its clusters have to be one run, long enough
+   //
+   if (entry >= 0) {
+      first = get16(&ent[26]);
+      if ((get16(&ent[28]) | (get16(&ent[30]) << 16)) < size)
+         return(BKUPFS_BADFILE);
+
+      for (i = 0, n = first; i < count; i++, n++) {
+         if ((n < 2) || (n >= (v.clusters + 2)))
+            return(BKUPFS_BADFILE);
+         if ((i < (count - 1)) && (fat_get(n) != (n + 1)))
+            return(BKUPFS_BADFILE);
+      }
+      return(v.datastart + ((first - 2) * v.clussize));
+   }
+
+   // new: the first run of count free clusters
+   //
+   if (freeent < 0)
+      return(BKUPFS_FULL);
+
+   for (first = 2, n = 0; (first + n) < (v.clusters + 2); ) {
+      if (fat_get(first + n) != 0) {
+         first += n + 1;
+         n = 0;
+      }
+      else if (++n == count)
+         break;
+   }
+   if (n < count)
+      return(BKUPFS_FULL);
+
+   // the chain, in each FAT (only the bytes which hold it change)
+   //
+   for (i = 0; i < count; i++)
+      fat_set(first + i, (i == (count - 1)) ? CLUSTER_END : (first + i + 1));
+
+   lo = first + (first >> 1);
+   hi = (first + count - 1) + ((first + count - 1) >> 1) + 1;
+   for (i = 0; i < v.numfats; i++)
+      bkupmem_write(v.fatstart + (i * v.fatsize) + lo, &fat[lo], hi - lo + 1);
+
+   // the data, cleared (a deleted file's may still be there)
+   //
+   for (i = 0; i < (count * v.clussize); i += DIRENTSIZE)
+      bkupmem_write(v.datastart + ((first - 2) * v.clussize) + i, zeroes, DIRENTSIZE);
+
+   // and then the entry
+   //
+   memset(ent, 0, DIRENTSIZE);
+   memcpy(ent, name, 11);
+   ent[11] = ATTR_ARCHIVE;
+   ent[26] = first & 0xFF;
+   ent[27] = first >> 8;
+   ent[28] = size & 0xFF;
+   ent[29] = (size >> 8) & 0xFF;
+   ent[30] = (size >> 16) & 0xFF;
+   bkupmem_write(v.dirstart + (freeent * DIRENTSIZE), ent, DIRENTSIZE);
+
+   return(v.datastart + ((first - 2) * v.clussize));
+}
@@ -0,0 +1,53 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// A file of our own in backup memory
+//
+// Internal backup memory is shared by every title: the BIOS keeps it as a
+// FAT12 volume (128-byte sectors, one FAT, a root directory and nothing
+// else), and its backup memory manager lists, and deletes, the files in
+// it.  So the save area (see save.h) is kept in a file, which the BIOS
+// and other titles know is taken:
+//
+// bkupfs_open(name, size) looks for the file in the root directory (name
+// is the 11 bytes of a directory entry, "NAME    EXT"), and makes it if
+// it isn't there, in the first run of free clusters which will hold size
+// bytes.  It returns the address of the file's data in backup memory
+// (always one run of clusters, so it is size bytes from there), or one of
+// the BKUPFS_xxx errors below, in which case nothing has been written.
+//
+// A new file's FAT chain is written first, then its data (zeroes), and
+// its directory entry last, so that power going off part way through only
+// loses a few clusters - never leaves an entry over clusters marked free.
+// A file which is there already is only used if it is big enough and its
+// clusters are all in one run, as bkupfs_open() makes them.
+//
+// Nothing here touches the hardware: the platform supplies bkupmem_read()
+// and bkupmem_write(), so that the host tools can use a file instead.
+//
+
+#ifndef BKUPFS_H
+#define BKUPFS_H
+
+#include <stdint.h>
+
+#define BKUPFS_MEMSIZE   0x8000	// internal backup memory, in bytes
+#define BKUPFS_FATMAX    1536	// biggest FAT looked at (1024 clusters)
+
+// results of bkupfs_open() (addresses are >= 0)
+//
+#define BKUPFS_NOFS      (-1)	// not a volume (unformatted, or not FAT12)
+#define BKUPFS_FULL      (-2)	// no directory entry, or no run of clusters, free
+#define BKUPFS_BADFILE   (-3)	// the file is there, but too small or in pieces
+
+// supplied by the platform: addr is from the start of backup memory
+//
+void bkupmem_read(int addr, uint8_t *buf, int len);
+void bkupmem_write(int addr, const uint8_t *buf, int len);
+
+int  bkupfs_open(const char *name, int size);
+
+#endif
@@ -20,25 +20,16 @@
 #include <eris/timer.h>
 #include <eris/pad.h>
 
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
-// Joypad defines (move these to library includes)
-//
-#define JOY_I            1
-#define JOY_II           2
-#define JOY_III          4
-#define JOY_IV           8
-#define JOY_V            16
-#define JOY_VI           32
-#define JOY_SELECT       64
-#define JOY_RUN          128
-#define JOY_UP           256
-#define JOY_RIGHT        512
-#define JOY_DOWN         1024
-#define JOY_LEFT         2048
-#define JOY_MODE1        4096
-#define JOY_MODE2        16384
+#include "game.h"
+#include "replay.h"
+#include "pad.h"
+#include "save.h"
+#include "bkupfs.h"
+#include "versus.h"
+#include "vram.h"
+#ifdef PROFILE
+#include "prof.h"
+#endif
 
 // HuC6270 defines (move these to library includes)
 //
@@ -109,11 +100,8 @@
 #define SPRITE_X_WIDTH_2	0x100
 #define SPRITE_PRIO_BG		0x0
 #define SPRITE_PRIO_SP		0x80
-#define SPRITE_PATTERN(vramaddr)	(vramaddr >> 5)
 
-
-#define SPR_CELL	0x0040
-#define SPR_32x32CELL	0x0100
+#define GHOST_PALETTE		8	// sprite palette for the ghost piece
 
 
 
@@ -126,68 +114,168 @@ typedef enum {
 // Constants used by program:
 //
 //
-#define CG_VRAMLOC       0x1000
-#define CG_FONTLOC       CG_VRAMLOC
-#define CG_GRAPHICS      (CG_VRAMLOC+0x1000)
+// VRAM addresses (VRAM_...) are given out by mkassets, from assets.txt;
+// only the characters listed there are in the font
+//
+#define CG_FONTLOC       (VRAM_FONT - (VRAM_FONT_FIRSTCHAR * CHR_SIZE))	// (where glyph 0 would be)
+
+#if (VRAM_BAT != 0)
+#error "the BG map has to be at VRAM 0 (see assets.txt)"
+#endif
+#if (VRAM_FONT < (VRAM_FONT_FIRSTCHAR * CHR_SIZE))
+#error "the font has to be placed higher in VRAM (see assets.txt)"
+#endif
+
+#define SATB_ENTRIES     64
 
-#define SPR_VRAMLOC      0x5000
-#define SATB_VRAMLOC     0xFF00
+#define VRAMQ_CMDS       64	// VRAM update queue: # of commands
+#define VRAMQ_WORDS      2048	// (# of data words)
+#define VRAMQ_BUDGET     512	// default # of words written per vblank
 
-#define BGMAPHEIGHT      32	// BG map is 32 tiles tiles
+#define BGMAPHEIGHT      64	// BG map is 64 tiles tall
 #define BGMAPWIDTH       64     // BG map is 64 tiles wide (incl. using 'virtual' mode)
 
-#define FIELDWIDTH       10	// Field size - # tiles wide
-#define FIELDHEIGHT      20	// (# tiles high)
-#define FIELDHIDHT       4	// height of 'hidden' portion at top
+// The BG map is used as four 32x32-tile screen "pages":
+// pages 0 and 1 (side by side) are the game screen, double-buffered -
+// the next frame is composed in whichever one is not being displayed,
+// and the BGX scroll register is flipped at vblank.  Page 2 (below
+// page 0) holds the pause screen, so pausing is just a scroll change.
+//
+#define BGPAGE_PAUSE     2
+#define PAGEX(page)      (((page) & 1) << 5)	// page origin, in tiles
+#define PAGEY(page)      (((page) >> 1) << 5)
 
-#define SCOREPOSX        3	// x-position of score message
-#define SCOREPOSY        3	// y-position of score message
 #define SCOREPAL         1	// CG palette # for printing scores
+#define SCOREDIGITS      5	// # of digits displayed
+#define SCORELEN         (7 + SCOREDIGITS)	// "SCORE: " and the digits
 
-#define FIELDX           20	// field x-position in tiles - top left corner
+// Screen layout, from the field size (see game.h).  The field sits at
+// the right of the screen, and the score to the left of it if there is
+// room (otherwise under it); the messages are centred over the field.
+//
+#define FIELDX           MIN(20, 32 - FIELDWIDTH)	// field x-position in tiles - top left corner
 #define FIELDY           1	// (y-position)    * includes hidden portion
+#define FIELDMIDY        (FIELDY + FIELDHIDHT + (FIELDHEIGHT / 2))	// (middle row, on screen)
+#define FIELDMSGX(len)   (FIELDX + ((FIELDWIDTH - (len)) / 2))	// x-position of a message centred on the field
 
-#define FLD_SPRXORG      (FIELDX*8+32)	// pixel-based origin x-position (for sprites)
+#define FLD_SPRXORG(x)   ((x)*8+32)	// pixel-based origin x-position, for field x (for sprites)
 #define FLD_SPRYORG      (FIELDY*8+64)	// (y-position)
 
-#define PAUSEMSGX        22	// pause message (x,y) location
-#define PAUSEMSGY        14
+#define P2FIELDX         2	// versus: player 2's field x-position in tiles
+#define VSSCOREY         (FIELDMIDY + (FIELDHEIGHT / 2) + 2)	// (y-position of both score messages, under the fields)
+
+#if (FIELDX >= (3 + SCORELEN + 1))
+#define SCOREPOSX        3	// x-position of score message
+#define SCOREPOSY        3	// y-position of score message
+#else
+#define SCOREPOSX        FIELDX
+#define SCOREPOSY        VSSCOREY
+#endif
+
+#if (VSSCOREY >= 30)
+#error "the field, and a score under it, have to fit in the 30 rows on screen"
+#endif
+
+#define PAUSEMSGX        FIELDMSGX(5)	// pause message (x,y) location
+#define PAUSEMSGY        (FIELDMIDY - 1)
+
+#define GAMOVRMSGX       FIELDMSGX(4)	// GAME OVER message (x,y) location
+#define GAMOVRMSGY       (FIELDMIDY - 1)
+
+#define WINMSGX          FIELDMSGX(6)	// versus: WINNER message x-location (at GAMOVRMSGY)
+
+#define REPLAYMSGX       FIELDMSGX(9)	// replay result message (x,y) location
+#define REPLAYMSGY       (FIELDMIDY + 2)
 
-#define GAMOVRMSGX       23	// GAME OVER message (x,y) location
-#define GAMOVRMSGY       14
+#define VBLANKTICKS      ((PAD_FRAMETICKS * 23) / 263)	// (23 of 263 lines)
 
-#define JOYRPTMASK       (JOY_LEFT|JOY_RIGHT|JOY_DOWN|JOY_I|JOY_II)
-#define JOYRPTINIT       15
-#define JOYRPTSUBS       3
+// The profiler readout goes to the left of the field, below the score.
+// When the field leaves no room there (FIELDWIDTH 14 and up) there is no
+// readout.
+//
+#define PROFMSGX         1	// profiler readout (x,y) location
+#define PROFMSGY         8
+#define PROFINTERVAL     30	// frames between readout updates
+#define PROF_FITS        (FIELDX >= (PROFMSGX + PROF_LINELEN + 1))
+
+#define RECBYTES         16384	// input recording buffer (see replay.h)
+
+#define BESTMSGX         (FIELDMSGX(10) + 1)	// best score message (x,y) location
+#define BESTMSGY         (FIELDMIDY + 4)
+
+#define ROTMSGX          FIELDMSGX(9)	// rotation system message (x,y) location
+#define ROTMSGY          (FIELDMIDY + 6)
+
+// the save area (see save.h) is kept in a file of its own in internal
+// backup memory (see bkupfs.h)
+//
+#define SAVEFILE         "BLOX    SAV"
+
+// pad 2's buttons are above pad 1's in the sampled pad (see my_timer_irq())
+//
+#define PAD2(buttons)    ((buttons) << 16)
+#define PAD1MASK         0xFFFF
+
+// RUN pauses (and resumes) the game; pad 2 only plays in versus, so it
+// only pauses then
+//
+#define PAUSEKEYS        (versus ? (JOY_RUN | PAD2(JOY_RUN)) : JOY_RUN)
+
+// The most VRAM words a versus frame can queue: both fields redrawn
+// completely, both scores changed, and the page flip on both chips.
+// This has to fit in one vblank's budget for 60 fps (blox-bench -2
+// measures what is actually reached; a PROFILE build times the vblank).
+// A field too wide for that, or for both fields to fit side by side,
+// leaves versus out of the game (the standard one has to have it).
+//
+#define VS_WORSTWORDS    ((VS_PLAYERS * FIELDHEIGHT * FIELDWIDTH) + (VS_PLAYERS * SCOREDIGITS) + 4)
+#define VS_FITS          ((VS_WORSTWORDS <= VRAMQ_BUDGET) && ((P2FIELDX + FIELDWIDTH) < FIELDX))
+
+#if (FIELDWIDTH == 10) && !VS_FITS
+#error "a versus frame's display updates might not fit in one vblank"
+#endif
 
 
+struct players;
 
 void print_text(VDCNUM vdc, int x_pos, int y_pos, int palette, char *mesg, int maxlen);
-void wait_joypad_run(void);
+uint32_t wait_joypad_run(void);
+uint32_t wait_joypad_rotation(void);
 void disp_blank_playfield(void);
+void show_bgpage(int page);
+void flip_bgpage(void);
+void set_sprite(VDCNUM vdc, int num, int x, int y, int pattern, int ctrl);
+void set_sprite_xy(VDCNUM vdc, int num, int x, int y);
+void commit_satb(VDCNUM vdc);
+void init_satb(void);
+uint16_t *vramq_begin(VDCNUM vdc, uint16_t addr, int len);
+void vramq_end(void);
+void vramq_write(VDCNUM vdc, uint16_t addr, const uint16_t *data, int len);
+void vramq_setreg(VDCNUM vdc, int reg, uint16_t value);
+void vramq_drain(void);
+void satb_push(void);
 void vsync(int numframes);
 void pause(void);
 void game_over(void);
-void sensejoy(void);
-void joypadmv(void);
-void setpiece(void);
-void setsprvars(void);
-void nxtpiece(void);
-void snapshot(int type, int phase, int xpos, int ypos);
-void init_score(void);
-void clear_display_field(void);
+void versus_over(int events0, int events1);
+void init_players(void);
+void setsprvars(struct players *pl);
 void dispbkgnd(void);
-void display_score(void);
-void disp_playfield(void);
-int chkmvok(int type, int phase, int xpos, int ypos, int xdelta, int ydelta);
+void disp_vdc1(void);
+void display_score(struct players *pl, int page);
+void disp_playfield(struct players *pl);
+void draw_player(struct players *pl);
 void init(void);
-void testlines(void);
-
-extern u8 font[];
+#ifdef PROFILE
+void prof_toggle(void);
+void disp_profile(void);
+#endif
 
 // interrupt-handling variables
 volatile int sda_frame_count = 0;
 volatile int last_sda_frame_count = 0;
+volatile uint32_t timerticks = 0;     // timer interrupts so far
+volatile uint32_t vblanktime = 0;     // timer_now() at the latest vblank
 
 /* HuC6270-A's status register (RAM mapping). Used during VSYNC interrupt */
 volatile uint16_t * const MEM_6270A_SR = (uint16_t *) 0x80000400;
@@ -196,60 +284,162 @@ int stepval = 0;
 
 
 
-//  Difficulty-level data:
-//  For now, it's a list of speed and next-level-starts-at scores
-//  speed is "vsync-frames per move", and score is in "lines cleared"
-
-typedef struct chlng_levels
-{
-   int    vsyncs;
-   char * score;
-} chlng_level;
-
-const chlng_level diff_level[] = {
-   { 30, "00004" },
-   { 24, "00009" }, 
-   { 20, "00014" }, 
-   { 16, "00019" }, 
-   { 12, "00029" }, 
-   { 10, "00039" }, 
-   { 8, "00049" }, 
-   { 6, "00059" }, 
-   { 5, "00069" }, 
-   { 4, "00079" }, 
-   { 3, "00099" }, 
-   { 2, "00119" }, 
-   { 1, "99999" }
-};
-
 char *scoremsg = "SCORE: ";
 char *pausemsg = "PAUSE";
 char *gameovermsg1 = "GAME";
 char *gameovermsg2 = "OVER";
+char *replayokmsg = "REPLAY OK";
+char *replayngmsg = "REPLAY NG";
+char bestmsg[]    = "BEST 00000";
+char *winnermsg = "WINNER";
+char *kicksonmsg  = "KICKS ON ";
+char *kicksoffmsg = "KICKS OFF";
+
+// Input recording:
+// each game's input is recorded; pressing SELECT+RUN at "GAME OVER"
+// plays the game back, and checks that it ends the same way
+//
+uint8_t   recbuf[RECBYTES];
+inputrec  rec;
+int       recvalid;        // whole game fit in recbuf
+uint32_t  recchecksum;     // game_checksum() at the end of the game
+int       recrotmode;      // rotation system it was played with
+inputplay play;
+int       replaying;
+
+// a game suspended (by pausing) when the power went off is carried on
+// with at boot, in place of a new one; it isn't recorded
+//
+int       resuming;
+
+// where the save file's data is in backup memory, or < 0 (BKUPFS_xxx) if
+// there is none - backup memory isn't formatted, or is full - in which
+// case nothing is saved, and the high scores only last until power-off
+//
+int       savebase;
+
+// Rotation system (see game_set_rotation()): pressing III at "GAME OVER"
+// switches between classic rotation and wall kicks, for the games after
+// it.  A resumed game carries on with the current one.
+//
+int       rotmode = ROT_CLASSIC;
+
+#ifdef PROFILE
+// Profiler readout: SELECT+VI shows/hides it, if it fits (PROF_FITS).  It
+// isn't drawn or toggled in versus, where player 2's field (on VDC1) is
+// over the same place; each game's background redraw clears it away.
+//
+int  profshown;
+int  profupdate;        // frames until it is next redrawn
+#endif
+
+// Players:
+// in single-player, player 0 is the only one.  In versus (started by
+// pressing RUN on pad 2 at "GAME OVER"), player 1's field and score are
+// drawn by VDC1, which is otherwise blank (see disp_vdc1()).  Each draws
+// its own gamestate: the one-player game, or its side of the match.
+//
+// Each keeps the score digits currently shown on each BG page (game pages
+// 0 and 1, and the pause page), so that only the digits which change need
+// to be rewritten, and which rows of each game page are out of date.
+//
+#define HUDPAGES         3
+
+typedef struct players
+{
+   gamestate *gs;
+   VDCNUM   vdc;
+   int      fieldx;                     // field x-position in tiles
+   int      scorex;                     // score message (x,y) location
+   int      scorey;
+   uint32_t pagedirty[2];
+   char     scoredigits[SCOREDIGITS];
+   int      scoredigitval;              // value scoredigits[] was made from
+   char     hudshown[HUDPAGES][SCOREDIGITS];
+   int      hudvalid[HUDPAGES];         // is the score message there at all ?
+} player;
+
+gamestate game;           // the one-player game
+vsmatch   vs;             // the versus match
+
+player players[VS_PLAYERS];
+int    versus;           // is this a two-player game ?
+int    vdc1shown;        // is there anything on VDC1 ?
+
+// VRAM words written during the current frame, and during the last
+// complete frame (for measuring the cost of display updates)
+//
+int vramwrcount;
+int vramwrlast;
+
+// VRAM update queue:
+// once interrupts are running, the game never touches the HuC6270
+// directly; it queues up VRAM writes and register writes, and the vblank
+// interrupt carries them out in order, up to vramq_budget words per
+// vblank - anything left over waits for the next vblank.
+//
+// Data for the commands is kept in a ring of words; each command's data
+// is contiguous (if it doesn't fit at the end of the ring, it starts over
+// at the beginning).  Head/tail values are free-running counters.
+//
+typedef struct vramcmds {
+   uint8_t  vdc;
+   uint8_t  reg;        // register # if len == 0
+   uint16_t addr;       // VRAM address (or register value if len == 0)
+   uint16_t len;        // # of words still to be written
+   uint32_t pos;        // position of next word in vramq_data
+} vramcmd;
 
-int  levelval;
-char scoreval[6];
+vramcmd  vramq_cmd[VRAMQ_CMDS];
+uint16_t vramq_data[VRAMQ_WORDS];
 
-int  frampermov;
-int  fpmcount;
+volatile uint32_t vramq_chead;   // commands queued
+volatile uint32_t vramq_ctail;   // commands completed
+volatile uint32_t vramq_dhead;   // data words reserved
+volatile uint32_t vramq_dtail;   // data words released
 
+uint32_t vramq_open;             // data position of command being built
 
-char displn[(FIELDHEIGHT+FIELDHIDHT)][FIELDWIDTH];
+int vramq_budget = VRAMQ_BUDGET;
 
-// joypad repeat values
+// statistics
 //
-int joyrptval;
-int joyfrminit;
-int joyfrmsubs;
-int joyout;
+int vramq_maxdepth;     // most commands ever waiting at once
+int vramq_deferred;     // # of vblanks which ran out of budget
 
-// piece type, rotation, position
-char pieceposx;
-char pieceposy;
-char piecenum;
-char phasenum;
+// BG page being displayed (0 or 1; the other one is drawn into) - on
+// both chips
+//
+int bgpage;
+
+// queue position of the most recent page flip; a page can't be drawn
+// into until the flip away from it has actually happened
+//
+uint32_t bgflipseq;
+
+// Shadow copy of the sprite attribute table:
+// sprites are set up here, and commit_satb() copies the entries in use to
+// the SATB image in VRAM (only if something changed), from where the
+// HuC6270 transfers them into the SATB itself during vblank
+//
+typedef struct satbentries {
+   uint16_t y;
+   uint16_t x;
+   uint16_t pattern;
+   uint16_t ctrl;
+} satbentry;
+
+// Each chip has its own.
+//
+satbentry satb[2][SATB_ENTRIES];
+int satbused[2];      // entries 0..satbused-1 are uploaded
+int satbdirty[2];
 
-int deletelines;
+// The committed SATBs, waiting for the timer interrupt to put them in VRAM
+// (see commit_satb())
+//
+satbentry satbout[2][SATB_ENTRIES];
+volatile int satboutlen[2];   // # of words; 0 if there's nothing waiting
 
 
 
@@ -277,6 +467,10 @@ const uint16_t CG_palette[] = {
   0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088,
 
 0x0088, 0xB897, 0x25B6, 0x82B5, 0x08A7, 0x42D5, 0x0088, 0x0088,
+  0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088,
+
+// pallette #8 - garbage squares (GARBAGECOLOUR - grey):
+0x0088, 0xB088, 0x6088, 0x9088, 0x4088, 0x7888, 0x0088, 0x0088,
   0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088
 };
 
@@ -304,18 +498,14 @@ const uint16_t SPR_palette[] = {
   0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088,
 
 0x0088, 0xB897, 0x25B6, 0x82B5, 0x08A7, 0x42D5, 0x0088, 0x0088,
+  0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088,
+
+// sprite pallette #8 - the ghost piece (dim grey):
+0x0088, 0x5088, 0x3888, 0x3888, 0x2888, 0x4088, 0x0088, 0x0088,
   0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088, 0x0088
 };
 
 
-#define OFFCHR_VRAMLOC		(CG_GRAPHICS)
-#define BKCHR1_VRAMLOC		(OFFCHR_VRAMLOC   +CHR_SIZE)
-#define BKCHR2_VRAMLOC		(BKCHR1_VRAMLOC   +CHR_SIZE)
-#define CORNERCHR_VRAMLOC	(BKCHR2_VRAMLOC   +CHR_SIZE)
-#define ENDCHR_VRAMLOC		(CORNERCHR_VRAMLOC+CHR_SIZE)
-#define BOTTOMCHR_VRAMLOC	(ENDCHR_VRAMLOC   +CHR_SIZE)
-#define FULLCHR_VRAMLOC		(BOTTOMCHR_VRAMLOC+CHR_SIZE)
-
 #define OFFCHR_PAL		0
 #define BKCHR1_PAL		0
 #define BKCHR2_PAL		0
@@ -325,72 +515,7 @@ const uint16_t SPR_palette[] = {
 #define FULLCHR_PAL		0
 
 
-#include "offchr_data.gen_data"
-#include "bkchr1_data.gen_data"
-#include "bkchr2_data.gen_data"
-#include "cornerchr_data.gen_data"
-#include "endchr_data.gen_data"
-#include "bottomchr_data.gen_data"
-#include "fullchr_data.gen_data"
-
-
-
-#define SPR_P0PH0VRAM	(SPR_VRAMLOC)
-#define SPR_P0PH1VRAM	(SPR_P0PH0VRAM+SPR_32x32CELL)
-#define SPR_P0PH2VRAM	(SPR_P0PH1VRAM+SPR_32x32CELL)
-#define SPR_P0PH3VRAM	(SPR_P0PH2VRAM+SPR_32x32CELL)
-
-#define SPR_P1PH0VRAM	(SPR_P0PH3VRAM+SPR_32x32CELL)
-#define SPR_P1PH1VRAM	(SPR_P1PH0VRAM+SPR_32x32CELL)
-#define SPR_P1PH2VRAM	(SPR_P1PH1VRAM+SPR_32x32CELL)
-#define SPR_P1PH3VRAM	(SPR_P1PH2VRAM+SPR_32x32CELL)
-
-#define SPR_P2PH0VRAM	(SPR_P1PH3VRAM+SPR_32x32CELL)
-#define SPR_P2PH1VRAM	(SPR_P2PH0VRAM+SPR_32x32CELL)
-#define SPR_P2PH2VRAM	(SPR_P2PH1VRAM+SPR_32x32CELL)
-#define SPR_P2PH3VRAM	(SPR_P2PH2VRAM+SPR_32x32CELL)
-
-#define SPR_P3PH0VRAM	(SPR_P2PH3VRAM+SPR_32x32CELL)
-#define SPR_P3PH1VRAM	(SPR_P3PH0VRAM+SPR_32x32CELL)
-
-#define SPR_P4PH0VRAM	(SPR_P3PH1VRAM+SPR_32x32CELL)
-#define SPR_P4PH1VRAM	(SPR_P4PH0VRAM+SPR_32x32CELL)
-
-#define SPR_P5PH0VRAM	(SPR_P4PH1VRAM+SPR_32x32CELL)
-#define SPR_P5PH1VRAM	(SPR_P5PH0VRAM+SPR_32x32CELL)
-
-#define SPR_P6PH0VRAM	(SPR_P5PH1VRAM+SPR_32x32CELL)
-
-#define SPR_P7PH0VRAM	(SPR_P6PH0VRAM+SPR_32x32CELL)
-
-
-#include "p0ph0_data.gen_data"
-#include "p0ph1_data.gen_data"
-#include "p0ph2_data.gen_data"
-#include "p0ph3_data.gen_data"
-
-#include "p1ph0_data.gen_data"
-#include "p1ph1_data.gen_data"
-#include "p1ph2_data.gen_data"
-#include "p1ph3_data.gen_data"
-
-#include "p2ph0_data.gen_data"
-#include "p2ph1_data.gen_data"
-#include "p2ph2_data.gen_data"
-#include "p2ph3_data.gen_data"
-
-#include "p3ph0_data.gen_data"
-#include "p3ph1_data.gen_data"
-
-#include "p4ph0_data.gen_data"
-#include "p4ph1_data.gen_data"
-
-#include "p5ph0_data.gen_data"
-#include "p5ph1_data.gen_data"
-
-#include "p6ph0_data.gen_data"
-
-#include "p7ph0_data.gen_data"
+#include "assets.h"
 
 
 
@@ -399,39 +524,37 @@ typedef struct BgChars
    uint16_t pal;
    uint16_t vidaddr;
    uint16_t ref;
-   const uint16_t *data;
-   uint16_t size;
 } Bgchr;
 
 // offchr character pattern = 8x8 all 0's:
 //
 const Bgchr offchr =
-{ OFFCHR_PAL, OFFCHR_VRAMLOC, CHRREF(OFFCHR_PAL, OFFCHR_VRAMLOC), offchr_data, sizeof(offchr_data) };
+{ OFFCHR_PAL, VRAM_OFFCHR, CHRREF(OFFCHR_PAL, VRAM_OFFCHR) };
 
 // bkchr1 character color pattern = 8x8 all 3's:
 //
 const Bgchr bkchr1 =
-{ BKCHR1_PAL, BKCHR1_VRAMLOC, CHRREF(BKCHR1_PAL, BKCHR1_VRAMLOC), bkchr1_data, sizeof(bkchr1_data) };
+{ BKCHR1_PAL, VRAM_BKCHR1, CHRREF(BKCHR1_PAL, VRAM_BKCHR1) };
 
 // bkchr2 character color pattern = 8x8 all 4's:
 //
 const Bgchr bkchr2 =
-{ BKCHR2_PAL, BKCHR2_VRAMLOC, CHRREF(BKCHR2_PAL, BKCHR2_VRAMLOC), bkchr2_data, sizeof(bkchr2_data) };
+{ BKCHR2_PAL, VRAM_BKCHR2, CHRREF(BKCHR2_PAL, VRAM_BKCHR2) };
 
 // cornerchr character color pattern = 8x8 all zeroes, except 1's on top edge and left edge:
 //
 const Bgchr cornerchr =
-{ CORNERCHR_PAL, CORNERCHR_VRAMLOC, CHRREF(CORNERCHR_PAL, CORNERCHR_VRAMLOC), cornerchr_data, sizeof(cornerchr_data) };
+{ CORNERCHR_PAL, VRAM_CORNERCHR, CHRREF(CORNERCHR_PAL, VRAM_CORNERCHR) };
 
 // endchr character color pattern = 8x8 all 0's except 1's on left edge:
 //
 const Bgchr endchr =
-{ ENDCHR_PAL, ENDCHR_VRAMLOC, CHRREF(ENDCHR_PAL, ENDCHR_VRAMLOC), endchr_data, sizeof(endchr_data) };
+{ ENDCHR_PAL, VRAM_ENDCHR, CHRREF(ENDCHR_PAL, VRAM_ENDCHR) };
 
 // bottomchr character color pattern = 8x8 all 0's except 1's on top edge:
 //
 const Bgchr bottomchr =
-{ BOTTOMCHR_PAL, BOTTOMCHR_VRAMLOC, CHRREF(BOTTOMCHR_PAL, BOTTOMCHR_VRAMLOC), bottomchr_data, sizeof(bottomchr_data) };
+{ BOTTOMCHR_PAL, VRAM_BOTTOMCHR, CHRREF(BOTTOMCHR_PAL, VRAM_BOTTOMCHR) };
 
 // fullchr character color pattern:
 // 11111113
@@ -444,100 +567,7 @@ const Bgchr bottomchr =
 // 24444444
 //
 const Bgchr fullchr =
-{ FULLCHR_PAL, FULLCHR_VRAMLOC, CHRREF(FULLCHR_PAL, FULLCHR_VRAMLOC), fullchr_data, sizeof(fullchr_data) };
-
-
-// Piece orientation information:
-// the square data is used for detecting existing filled-blocks
-// (for collision-detection), and for sprite-to-block transfer
-// when the piece comes to rest
-//
-// sprite_x_rotate_adjustment (and y) is only used for piece #2, to
-// compensate for its special rotation (around its second square)
-//
-//
-// game pieces' data
-// -----------------
-//
-// piece #:         0     1     2     3     4     5     6
-//
-// appearance:      XX    XX    X     X      X    X     XX
-//                  X      X    XX    X     XX    XX    XX
-//                  X      X    X     X     X      X
-//                                    X
-// # rotation
-//   phases:        4     4     4     2     2     2     1
-//
-
-struct sqrpos {
-   int x;
-   int y;
-};
-
-typedef struct piecephasedatas {
-   int           width;
-   int           height;
-   struct sqrpos square[4];
-   uint16_t      sprpattern_vram_addr;
-   int           sprite_x_rotate_adjustment;
-   int           sprite_y_rotate_adjustment;
-} piecephasedata;
-
-
-const piecephasedata p0phstbl[4] = {
-	{ 2, 3, {{0, 0}, {1, 0}, {0, 1}, {0, 2}}, SPR_P0PH0VRAM, 0, 0 },
-	{ 3, 2, {{0, 0}, {0, 1}, {1, 1}, {2, 1}}, SPR_P0PH1VRAM, 0, 0 },
-	{ 2, 3, {{1, 0}, {1, 1}, {1, 2}, {0, 2}}, SPR_P0PH2VRAM, 0, 0 },
-	{ 3, 2, {{0, 0}, {1, 0}, {2, 0}, {2, 1}}, SPR_P0PH3VRAM, 0, 0 }
-};
-
-const piecephasedata p1phstbl[4] = {
-	{ 2, 3, {{0, 0}, {1, 0}, {1, 1}, {1, 2}}, SPR_P1PH0VRAM, 0, 0 },
-	{ 3, 2, {{0, 0}, {0, 1}, {1, 0}, {2, 0}}, SPR_P1PH1VRAM, 0, 0 },
-	{ 2, 3, {{0, 0}, {0, 1}, {0, 2}, {1, 2}}, SPR_P1PH2VRAM, 0, 0 },
-	{ 3, 2, {{0, 1}, {1, 1}, {2, 1}, {2, 0}}, SPR_P1PH3VRAM, 0, 0 }
-};
-
-const piecephasedata p2phstbl[4] = {
-	{ 2, 3, {{0, 0}, {0, 1}, {1, 1}, {0, 2}}, SPR_P2PH0VRAM, 0, 0 },
-	{ 3, 2, {{0, 1}, {1, 0}, {1, 1}, {2, 1}}, SPR_P2PH1VRAM, 0, 0 },
-	{ 2, 3, {{0, 1}, {1, 0}, {1, 1}, {1, 2}}, SPR_P2PH2VRAM, 0, 0 },
-	{ 3, 2, {{0, 0}, {1, 0}, {2, 0}, {1, 1}}, SPR_P2PH3VRAM, 0, 0 }
-};
-
-const piecephasedata p3phstbl[4] = {
-	{ 1, 4, {{0, 0}, {0, 1}, {0, 2}, {0, 3}}, SPR_P3PH0VRAM,  1, -1 },
-	{ 4, 1, {{0, 0}, {1, 0}, {2, 0}, {3, 0}}, SPR_P3PH1VRAM, -1,  1 },
-	{ 1, 4, {{0, 0}, {0, 1}, {0, 2}, {0, 3}}, SPR_P3PH0VRAM,  1, -1 },  // Last two are same as first two
-	{ 4, 1, {{0, 0}, {1, 0}, {2, 0}, {3, 0}}, SPR_P3PH1VRAM, -1,  1 }
-};
-
-const piecephasedata p4phstbl[4] = {
-	{ 2, 3, {{1, 0}, {1, 1}, {0, 1}, {0, 2}}, SPR_P4PH0VRAM, 0, 0 },
-	{ 3, 2, {{0, 0}, {1, 0}, {1, 1}, {2, 1}}, SPR_P4PH1VRAM, 0, 0 },
-	{ 2, 3, {{1, 0}, {1, 1}, {0, 1}, {0, 2}}, SPR_P4PH0VRAM, 0, 0 },  // Last two are same as first two
-	{ 3, 2, {{0, 0}, {1, 0}, {1, 1}, {2, 1}}, SPR_P4PH1VRAM, 0, 0 }
-};
-
-const piecephasedata p5phstbl[4] = {
-	{ 2, 3, {{0, 0}, {0, 1}, {1, 1}, {1, 2}}, SPR_P5PH0VRAM, 0, 0 },
-	{ 3, 2, {{0, 1}, {1, 1}, {1, 0}, {2, 0}}, SPR_P5PH1VRAM, 0, 0 },
-	{ 2, 3, {{0, 0}, {0, 1}, {1, 1}, {1, 2}}, SPR_P5PH0VRAM, 0, 0 },  // Last two are same as first two
-	{ 3, 2, {{0, 1}, {1, 1}, {1, 0}, {2, 0}}, SPR_P5PH1VRAM, 0, 0 }
-};
-
-const piecephasedata p6phstbl[4] = {
-	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, SPR_P6PH0VRAM, 0, 0 },
-	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, SPR_P6PH0VRAM, 0, 0 },  // Last three are same as first one
-	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, SPR_P6PH0VRAM, 0, 0 },
-	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, SPR_P6PH0VRAM, 0, 0 }
-};
-
-// Note: It should not be odd to reference individual square positions as:
-// (piecetbl[piecenum] + phasenum)->square[squarenum].x
-const piecephasedata * piecetbl[7] = {
-   p0phstbl, p1phstbl, p2phstbl, p3phstbl, p4phstbl, p5phstbl, p6phstbl
-};
+{ FULLCHR_PAL, VRAM_FULLCHR, CHRREF(FULLCHR_PAL, VRAM_FULLCHR) };
 
 
 
@@ -548,20 +578,34 @@ volatile u32 joypad_last;
 volatile u32 joytrg;
 
 
+// The pad itself is read by the timer interrupt (see pad.h); once per
+// frame, joypad and joytrg are set from it for the menus and pause
+// (joytrg has every button pressed since the last vblank)
+//
 __attribute__ ((noinline)) void joyread(void)
 {
-// assume that this is a joypad and not a mouse
-// Maybe need to fix this later
-
    joypad_last = joypad;
 
-   joypad = eris_pad_read(0);
+   joypad = padheld;
 
-   joytrg = (~joypad_last) & joypad;
+   joytrg = padtrg;
+   padtrg = 0;
+}
 
-//   if ( ((temp >> 28) & 0x0F) == (~PAD_TYPE_FXPAD & 0x0f) ) {  // PAD TYPE
-//   }
-//   joypad = temp;
+// Ticks since the timer was started; the timer counts down from
+// PAD_PERIOD, and interrupts each time it gets to 0
+//
+uint32_t timer_now(void)
+{
+uint32_t ticks;
+uint16_t count;
+
+   do {
+      ticks = timerticks;
+      count = eris_timer_read_counter();
+   } while (ticks != timerticks);
+
+   return((ticks * PAD_PERIOD) + (PAD_PERIOD - count));
 }
 
 
@@ -573,9 +617,26 @@ __attribute__ ((interrupt_handler)) void my_vblank_irq (void)
    uint16_t vdc_status = *MEM_6270A_SR;
 
    if (vdc_status & HUC6270_STAT_VD ) {
+      vblanktime = timer_now();
       sda_frame_count++;
+      vramq_drain();
+#ifdef PROFILE
+      prof_vblank(timer_now() - vblanktime);
+#endif
+      joyread();
    }
-   joyread();
+}
+
+__attribute__ ((interrupt_handler)) void my_timer_irq (void)
+{
+// assume that this is a joypad and not a mouse
+// Maybe need to fix this later
+
+   eris_timer_ack_irq();
+   timerticks++;
+
+   pad_sample((eris_pad_read(0) & PAD1MASK) | PAD2(eris_pad_read(1) & PAD1MASK), timer_now());
+   satb_push();
 }
 
 void vsync(int numframes)
@@ -583,6 +644,9 @@ void vsync(int numframes)
    while (sda_frame_count < (last_sda_frame_count + numframes + 1));
 
    last_sda_frame_count = sda_frame_count;
+
+   vramwrlast  = vramwrcount;
+   vramwrcount = 0;
 }
 
 
@@ -616,513 +680,1080 @@ __attribute__ ((noinline)) void step(void)
 //   return(vid_data);
 //}
 
-void load_vram(VDCNUM vdc_num, const uint16_t *data, uint16_t vid_addr, uint16_t size)
+static inline void vram_write(VDCNUM vdc_num, uint16_t vid_data)
 {
-int i;
+   eris_low_sup_vram_write(vdc_num, vid_data);
+   vramwrcount++;
+}
 
+// Boot-time uploads: the data register is selected once, and after that
+// only the data port is written (the eris_ calls select the register
+// again for every word).  Nothing else may use the chip in the meantime,
+// so these are only for init(), before the vblank interrupt is on.
+//
+#define VDC_PORT(vdc)      (0x400 | ((vdc) << 8))	// (register select)
+#define VDC_DATA(vdc)      (VDC_PORT(vdc) | 4)
+#define KING_PORT          0x600
+#define KING_DATA          0x604
+#define KING_REG_KRAMDATA  0x0E
+#define TETSU_PORT         0x300
+#define TETSU_DATA         0x302
+#define TETSU_REG_PALADDR  0x01
+#define TETSU_REG_PALDATA  0x02
+
+static inline void vram_stream(VDCNUM vdc_num, uint16_t vid_addr)
+{
    eris_low_sup_set_vram_write(vdc_num, vid_addr);
+   out16(VDC_PORT(vdc_num), HUC6270_REG_DATA);
+}
 
-   for (i = 0; i < size; i++)
-   {
-      eris_low_sup_vram_write(vdc_num, *data);
-      data++;
-   }
+// Fill KRAM from the current write address (eris_king_set_kram_write())
+//
+void kram_fill(uint16_t val, int words)
+{
+   out16(KING_PORT, KING_REG_KRAMDATA);
+   while (words-- > 0)
+      out16(KING_DATA, val);
 }
 
+// Palette entries first ... first+count-1
+//
+void load_palette(int first, const uint16_t *colors, int count)
+{
+   out16(TETSU_PORT, TETSU_REG_PALADDR);
+   out16(TETSU_DATA, first);
+   out16(TETSU_PORT, TETSU_REG_PALDATA);
+   while (count-- > 0)
+      out16(TETSU_DATA, *colors++);
+}
 
-int main(int argc, char *argv[])
+// Unpack graphics (see assetpack.h) straight into VRAM, as one stream
+//
+void load_asset(VDCNUM vdc_num, const assetpack *pack, uint16_t vid_addr)
 {
-   init();
+const uint8_t *src;
+int i, n, code, words;
+uint16_t val;
+
+   vram_stream(vdc_num, vid_addr);
+
+   for (i = 0; i < pack->numcells; i++) {
+      src   = &assetcells[assetcelloff[pack->cells[i]]];
+      words = pack->cellwords;
+
+      while (words > 0) {
+         code   = *src++;
+         n      = (code & ASSET_COUNTMASK) + 1;
+         words -= n;
+
+         switch (code & ASSET_CODEMASK) {
+         case ASSET_ZERO:
+            while (n-- > 0)
+               out16(VDC_DATA(vdc_num), 0);
+            break;
+
+         case ASSET_RUN:
+            val = src[0] | (src[1] << 8);
+            src += 2;
+            while (n-- > 0)
+               out16(VDC_DATA(vdc_num), val);
+            break;
+
+         default:       // ASSET_WORDS
+            while (n-- > 0) {
+               out16(VDC_DATA(vdc_num), src[0] | (src[1] << 8));
+               src += 2;
+            }
+            break;
+         }
+      }
+   }
+}
 
-//TODO:  Initialize random number generator
+// Everything mkassets put in VRAM (the font, tiles and sprites), one
+// stream of writes per range
+//
+void load_vram_image(VDCNUM vdc_num)
+{
+int i;
 
+   for (i = 0; i < VRAMIMAGE_RANGES; i++)
+      load_asset(vdc_num, &vramimage[i].pack, vramimage[i].addr);
+}
 
-   while (1)     // This is a loop for games (each iteration is a game)
-   {
 
-      // intialization
-      //
-      init_score();
+///////////////////////////////// VRAM update queue
 
-      clear_display_field();
+// Reserve space for 'len' words to be written at VRAM address 'addr';
+// the caller fills them in, then calls vramq_end() to queue them.
+// Waits (for the vblank interrupt to make room) if the queue is full.
+//
+uint16_t *vramq_begin(VDCNUM vdc, uint16_t addr, int len)
+{
+uint32_t pos;
+vramcmd *cmd;
 
-      // set initial difficulty level
-      //
-      levelval = 0;
-      frampermov = diff_level[levelval].vsyncs;
+   pos = vramq_dhead;
 
-      // Wait for a vsync to reduce initial screen flash
-      //
-      vsync(0);
+   if (((pos % VRAMQ_WORDS) + len) > VRAMQ_WORDS)   // doesn't fit before the end
+      pos += VRAMQ_WORDS - (pos % VRAMQ_WORDS);
 
-      // display startup screen
-      //
-      dispbkgnd();
-      display_score();
-      disp_playfield();
+   while (((pos + len) - vramq_dtail) > VRAMQ_WORDS);
+   while ((vramq_chead - vramq_ctail) >= VRAMQ_CMDS);
 
-//TODO:  Get a random piece number
-      piecenum  = 0;
+   cmd = &vramq_cmd[vramq_chead % VRAMQ_CMDS];
+   cmd->vdc  = vdc;
+   cmd->reg  = 0;
+   cmd->addr = addr;
+   cmd->len  = len;
+   cmd->pos  = pos;
 
-      setpiece();
+   vramq_open = pos + len;
 
-      // set countdown interval - number of frames until piece moves downward
-      //
-      fpmcount = frampermov;
+   return(&vramq_data[pos % VRAMQ_WORDS]);
+}
 
-      while (1)     // This is a loop for vsyncs within a game
-      {
-         deletelines = 0;
+void vramq_end(void)
+{
+   vramq_dhead = vramq_open;
+   vramq_chead++;
 
-//TODO:  More randomization
+   if ((int)(vramq_chead - vramq_ctail) > vramq_maxdepth)
+      vramq_maxdepth = vramq_chead - vramq_ctail;
+}
 
-         sensejoy();      // figure out joypad auto-repeat
-         joypadmv();      // move
+void vramq_write(VDCNUM vdc, uint16_t addr, const uint16_t *data, int len)
+{
+   memcpy(vramq_begin(vdc, addr, len), data, len * sizeof(uint16_t));
+   vramq_end();
+}
 
-         joyout = 0;      // reset
+void vramq_setreg(VDCNUM vdc, int reg, uint16_t value)
+{
+vramcmd *cmd;
 
-         if ((joytrg & JOY_RUN) == JOY_RUN) {
-            pause();
-         }
+   while ((vramq_chead - vramq_ctail) >= VRAMQ_CMDS);
 
-         fpmcount--;      // is it time to move pice down ?
+   cmd = &vramq_cmd[vramq_chead % VRAMQ_CMDS];
+   cmd->vdc  = vdc;
+   cmd->reg  = reg;
+   cmd->addr = value;
+   cmd->len  = 0;
+   cmd->pos  = vramq_dhead;
 
-         if (fpmcount == 0) {
+   vramq_open = vramq_dhead;
+   vramq_end();
+}
 
-            // check if score exceeds threshold to increase difficulty
-            if (strcmp(scoreval, diff_level[levelval].score) >= 0) {
-               levelval++;
-               frampermov = diff_level[levelval].vsyncs;
-            }
+// Called from the vblank interrupt: carry out queued commands, up to
+// vramq_budget words (a register write counts as one word)
+//
+void vramq_drain(void)
+{
+vramcmd *cmd;
+const uint16_t *data;
+int budget = vramq_budget;
+int n;
+
+   while (vramq_ctail != vramq_chead) {
+      if (budget <= 0) {
+         vramq_deferred++;
+         break;
+      }
 
-            fpmcount = frampermov;     // reset down-counter
+      cmd = &vramq_cmd[vramq_ctail % VRAMQ_CMDS];
 
-            // move pirce downward (if possible)
-            if (chkmvok(piecenum, phasenum, pieceposx, pieceposy, 0, 1) == 0) {
-               pieceposy++;
-            }
-            else {
-               // transfer to background
-               snapshot(piecenum, phasenum, pieceposx, pieceposy);
-
-               // check if any part is still in the 'hidden' area at the top
-               // if so, "game over"
-               if (pieceposy < FIELDHIDHT) {     // are any of the current piece's squares in the hidden area ?
-                  game_over();                   // yes, it's game_over
-                  break;
-               }
-               else {
-                  testlines();     // delete complete lines & add score
-                  nxtpiece();      // set next piece
-               }
-            }
-         }
+      if (cmd->len == 0) {
+         eris_low_sup_setreg(cmd->vdc, cmd->reg, cmd->addr);
+         budget--;
+      }
+      else {
+         n = MIN(cmd->len, budget);
+         data = &vramq_data[cmd->pos % VRAMQ_WORDS];
 
-         setsprvars();
+         eris_low_sup_set_vram_write(cmd->vdc, cmd->addr);
 
-         display_score();
-         disp_playfield();
+         cmd->addr += n;
+         cmd->len  -= n;
+         cmd->pos  += n;
+         budget    -= n;
 
-         vsync(0);
+         while (n-- > 0)
+            vram_write(cmd->vdc, *data++);
+
+         if (cmd->len != 0) {     // out of budget part-way through
+            vramq_deferred++;
+            break;
+         }
       }
+      vramq_dtail = cmd->pos;
+      vramq_ctail++;
    }
+}
 
-   return 0;
+
+///////////////////////////////// Sprites
+
+void set_sprite(VDCNUM vdc, int num, int x, int y, int pattern, int ctrl)
+{
+satbentry *spr = &satb[vdc][num];
+
+   if ((spr->x != x) || (spr->y != y) || (spr->pattern != pattern) || (spr->ctrl != ctrl)) {
+      spr->x         = x;
+      spr->y         = y;
+      spr->pattern   = pattern;
+      spr->ctrl      = ctrl;
+      satbdirty[vdc] = 1;
+   }
+
+   if (num >= satbused[vdc])
+      satbused[vdc] = num + 1;
 }
 
-void pause(void)
+void set_sprite_xy(VDCNUM vdc, int num, int x, int y)
 {
-int palette = 0;
+satbentry *spr = &satb[vdc][num];
 
-   disp_blank_playfield();
+   set_sprite(vdc, num, x, y, spr->pattern, spr->ctrl);
+}
 
-   print_text(VDC0, PAUSEMSGX, PAUSEMSGY, palette, pausemsg, 5);
+// Commit the shadow SATB.  Writing DVSSR makes the HuC6270 do the
+// VRAM->SATB transfer at the start of the next vblank, so if the SATB went
+// through the VRAM queue (which is drained during vblank), sprite changes
+// would show up a frame after the BG changes queued with them.  Instead,
+// the timer interrupt writes it during the display (satb_push()), and it
+// is transferred at the same vblank as the BG changes are written.
+//
+void commit_satb(VDCNUM vdc)
+{
+   if (satbdirty[vdc] == 0)
+      return;
 
-   wait_joypad_run();
+   irq_disable();
+   memcpy(satbout[vdc], satb[vdc], satbused[vdc] * sizeof(satbentry));
+   satboutlen[vdc] = satbused[vdc] * 4;
+   irq_enable();
 
-   disp_playfield();
+   satbdirty[vdc] = 0;
 }
 
-void game_over(void)
+// Called from the timer interrupt; not during the vblank, as the
+// transfer may be going on then (that waits for the next interrupt).
+// Both chips share the same timing, so one check does for both.
+//
+void satb_push(void)
 {
-int palette = 0;
+int i, vdc;
+const uint16_t *data;
 
-   print_text(VDC0, GAMOVRMSGX, GAMOVRMSGY, palette, gameovermsg1, 4);
-   print_text(VDC0, GAMOVRMSGX, GAMOVRMSGY+1, palette, gameovermsg2, 4);
+   if ((timer_now() - vblanktime) < VBLANKTICKS)
+      return;
 
-   wait_joypad_run();
+   for (vdc = VDC0; vdc <= VDC1; vdc++) {
+      if (satboutlen[vdc] == 0)
+         continue;
+
+      data = (const uint16_t *)satbout[vdc];
+
+      eris_low_sup_set_vram_write(vdc, VRAM_SATB);
+      for (i = 0; i < satboutlen[vdc]; i++)
+         vram_write(vdc, data[i]);
+
+      eris_low_sup_setreg(vdc, HUC6270_REG_DVSSR, VRAM_SATB);
+
+      satboutlen[vdc] = 0;
+   }
 }
 
-void sensejoy(void)
+// Called from init(), after both chips' VRAM has been loaded.  The timer
+// interrupt is already running by then (it is started at the top of
+// init()), and its satb_push() writes VRAM too - that is only safe because
+// nothing has been committed yet, so satboutlen[] is still 0 and it
+// leaves VRAM alone
+//
+void init_satb(void)
 {
-int temppad;
+int i, vdc;
 
-   temppad = joypad & JOYRPTMASK;
+   memset(satb, 0, sizeof(satb));
 
-   if (temppad == joyrptval) {
-      if (joyfrminit >= JOYRPTINIT) {     // initial wait period is done
-         if (joyfrmsubs >= JOYRPTSUBS) {  // is it time to repeat ?
-            joyout = joyrptval;
-	    joyfrmsubs = 0;
-         }
-         else {
-            joyfrmsubs++;
-         }
-      }
-      else {
-         // wait for initial period
-         joyfrminit++;
-	 joyfrmsubs = 0;
-      }
+   for (vdc = VDC0; vdc <= VDC1; vdc++) {
+      eris_low_sup_setreg(vdc, HUC6270_REG_DCR, 0);   // no auto-repeat of SATB transfer
+
+      eris_low_sup_set_vram_write(vdc, VRAM_SATB);
+
+      for (i = 0; i < (SATB_ENTRIES * 4); i++)
+         vram_write(vdc, 0);
 
-      
-   } else {
-      // different
-      joyout     = temppad;   // output keys
-      joyrptval  = temppad;   // keep for later (repeat validation)
-      joyfrminit = 0;         // init counters
-      joyfrmsubs = 0;
+      eris_low_sup_setreg(vdc, HUC6270_REG_DVSSR, VRAM_SATB);
+
+      satbused[vdc]  = 0;
+      satbdirty[vdc] = 0;
    }
 }
 
-void joypadmv(void)
+
+int main(int argc, char *argv[])
 {
-int tempphase;
-int rotatex;
-int rotatey;
+int events, events1;
+uint32_t pad, seed;
+uint32_t deadline, latchtime;
+int32_t latency;
 
-   if ((joyout & JOY_LEFT) == JOY_LEFT)
-      if (chkmvok(piecenum, phasenum, pieceposx, pieceposy, -1, 0) == 0)
-         pieceposx--;
+   init();
 
-   if ((joyout & JOY_RIGHT) == JOY_RIGHT)
-      if (chkmvok(piecenum, phasenum, pieceposx, pieceposy, 1, 0) == 0)
-         pieceposx++;
+   savebase = bkupfs_open(SAVEFILE, SAVE_AREASIZE);
+   resuming = (save_init() == SAVE_OK);
 
-//   if ((joytrg & JOY_UP) == JOY_UP)
-//      if (chkmvok(piecenum, phasenum, pieceposx, pieceposy, 0, -1) == 0)
-//         pieceposy--;
+   while (1)     // This is a loop for games (each iteration is a game)
+   {
 
-   if ((joyout & JOY_DOWN) == JOY_DOWN) {
-      if (chkmvok(piecenum, phasenum, pieceposx, pieceposy, 0, 1) == 0)
-         pieceposy++;
-   }
+      // intialization - the pieces are seeded from the frame count
+      // (i.e. how long the player took to press RUN at "GAME OVER") and
+      // the timer.  The first game after power-on starts without waiting
+      // for RUN, so for that one it is the timer which varies: how long
+      // boot took (the CD's timing), to the tick.
+      //
+      seed = sda_frame_count + timer_now();
 
-   if ((joyout & JOY_I) == JOY_I) {
-      tempphase = ((phasenum + 1) & 3);
-      rotatex = (piecetbl[(int)piecenum] + tempphase)->sprite_x_rotate_adjustment;
-      rotatey = (piecetbl[(int)piecenum] + tempphase)->sprite_y_rotate_adjustment;
+      game_set_rotation(&game, replaying ? recrotmode : rotmode);
+      game_set_rotation(&vs.game[0], rotmode);
+      game_set_rotation(&vs.game[1], rotmode);
 
-      if (chkmvok(piecenum, tempphase, pieceposx, pieceposy, rotatex, rotatey) == 0) {
-         phasenum   = tempphase;
-         pieceposx += rotatex;
-         pieceposy += rotatey;
+      if (versus) {
+         versus_start(&vs, seed);
+         recvalid = 0;
       }
-   }
+      else if (replaying) {
+         game_start(&game, rec.seed);
+         play_start(&play, recbuf, rec.len);
+      }
+      else if (resuming && (load_game(&game) == SAVE_OK)) {
+         recvalid = 0;
+      }
+      else {
+         game_start(&game, seed);
+         rec_start(&rec, recbuf, RECBYTES, seed);
+         recrotmode = rotmode;
+         recvalid   = 1;
+      }
+
+      // Wait for a vsync to reduce initial screen flash
+      //
+      resuming = 0;
 
-   if ((joyout & JOY_II) == JOY_II) {
-      tempphase = ((phasenum + 3) & 3);
-      rotatex = (piecetbl[(int)piecenum] + tempphase)->sprite_x_rotate_adjustment;
-      rotatey = (piecetbl[(int)piecenum] + tempphase)->sprite_y_rotate_adjustment;
+      vsync(0);
 
-      if (chkmvok(piecenum, tempphase, pieceposx, pieceposy, rotatex, rotatey) == 0) {
-         phasenum   = tempphase;
-         pieceposx += rotatex;
-         pieceposy += rotatey;
+      // display startup screen
+      //
+      init_players();
+      dispbkgnd();
+      disp_vdc1();
+      disp_blank_playfield();
+      if (versus) {
+         display_score(&players[1], bgpage ^ 1);
+         disp_playfield(&players[1]);
+      }
+      display_score(&players[0], bgpage ^ 1);
+      disp_playfield(&players[0]);
+      flip_bgpage();
+
+      pad_latch(timer_now(), &latency);     // (drop anything from before the game)
+
+      while (1)     // This is a loop for vsyncs within a game
+      {
+         if ((joytrg & PAUSEKEYS) != 0) {
+            pause();
+            pad_latch(timer_now(), &latency);
+         }
+
+         // latch the pad as late in the frame as there is time for
+         //
+         deadline = pad_deadline(vblanktime);
+         while (((int32_t)(timer_now() - deadline) < 0) && (sda_frame_count == last_sda_frame_count));
+
+#ifdef PROFILE
+         prof_frame_start();
+
+         if (((joypad & JOY_SELECT) == JOY_SELECT) && ((joytrg & JOY_VI) == JOY_VI))
+            prof_toggle();
+#endif
+
+         latchtime = timer_now();
+         pad = pad_latch(latchtime, &latency);
+         if (!versus)
+            pad &= PAD1MASK;      // (pad 2 only plays in versus)
+
+#ifdef PROFILE
+         if ((latency >= 0) && !replaying)
+            prof_latency(latency);
+#endif
+
+         if (replaying) {
+            if (play_frame(&play, &pad) == 0) {   // recording ran out early
+               game_over();
+               break;
+            }
+         }
+         else if (recvalid) {
+            recvalid = rec_frame(&rec, pad);
+         }
+
+         if (versus) {
+            // both games run before either is drawn, so that a match
+            // which both lose in the same frame is a draw
+            //
+            events  = versus_frame(&vs, 0, pad & PAD1MASK);
+            events1 = versus_frame(&vs, 1, (pad >> 16) & PAD1MASK);
+
+            if ((events | events1) & GAME_OVER) {
+               versus_over(events, events1);
+               break;
+            }
+
+            draw_player(&players[1]);
+         }
+         else {
+            events = game_frame(&game, pad);
+
+            if (events & GAME_OVER) {
+               game_over();
+               break;
+            }
+         }
+
+         draw_player(&players[0]);
+
+         flip_bgpage();
+
+#ifdef PROFILE
+         // if a vblank has gone by since this frame started, the work
+         // wasn't ready in time
+         //
+         prof_frame_end(sda_frame_count != last_sda_frame_count);
+         disp_profile();
+#endif
+
+         pad_work(timer_now() - latchtime);
+
+         vsync(0);
       }
    }
 
-//   if ((joytrg & JOY_III) == JOY_III) {
-//      if (piecenum == 6)
-//         piecenum = 0;
-//      else
-//         piecenum++;
-//   }
-//
-//   if ((joytrg & JOY_IV) == JOY_IV) {
-//      if (piecenum == 0)
-//         piecenum = 6;
-//      else
-//         piecenum--;
-//   }
+   return 0;
 }
 
-void nxtpiece(void)
+// Internal backup memory, for bkupfs.c
+//
+void bkupmem_read(int addr, uint8_t *buf, int len)
 {
-// actually, this should get a random number from 0 to 6
-   piecenum++;
-
-   if (piecenum > 6)
-      piecenum = 0;
-   setpiece();
+   eris_bkupmem_read(0, buf, addr, len);
 }
 
-void setpiece(void)
+void bkupmem_write(int addr, const uint8_t *buf, int len)
 {
-   phasenum = 0;
-   pieceposy = FIELDHIDHT - (piecetbl[(int)piecenum] + phasenum)->height;
-   pieceposx = (FIELDWIDTH - (piecetbl[(int)piecenum] + phasenum)->width) >> 1;
-   setsprvars();
+   eris_bkupmem_write(0, (uint8_t *)buf, addr, len);
 }
 
-int chkmvok(int type, int phase, int xpos, int ypos, int xdelta, int ydelta)
+// The save area, for save.c: the save file, or (if there is none) nothing
+// saved, and nothing written
+//
+void bkup_read(int addr, uint8_t *buf, int len)
 {
-int i, xoffset, yoffset;
-int flag;
+   if (savebase < 0)
+      memset(buf, 0, len);
+   else
+      bkupmem_read(savebase + addr, buf, len);
+}
 
-   flag = 0;
+void bkup_write(int addr, const uint8_t *buf, int len)
+{
+   if (savebase >= 0)
+      bkupmem_write(savebase + addr, buf, len);
+}
 
-   for (i = 0; i < 4; i++) {
-      xoffset = (piecetbl[(int)type] + phase)->square[i].x;
-      yoffset = (piecetbl[(int)type] + phase)->square[i].y;
+void pause(void)
+{
+   display_score(&players[0], BGPAGE_PAUSE);
+   show_bgpage(BGPAGE_PAUSE);
 
-      // Check whether movement would put it out of bounds:
-      // 
-      if ( ((xpos + xdelta + xoffset) < 0) ||
-           ((xpos + xdelta + xoffset) >= FIELDWIDTH) || 
-           ((ypos + ydelta + yoffset) < 0) ||
-           ((ypos + ydelta + yoffset) >= (FIELDHEIGHT + FIELDHIDHT)) )
-      {
-         flag = 1;
-	 break;
-      }
+   // suspend the game, in case the power goes off while paused (a versus
+   // match isn't saved)
+   //
+   if (!replaying && !versus)
+      save_game(&game);
 
-      // Check whether movement would have it collide with terrain:
-      // 
-      if ((displn[ypos + ydelta + yoffset][xpos + xdelta + xoffset]) != 0) {
-         flag = 1;
-	 break;
-      }
+// Move sprites 2 and 3 (the piece and its ghost) off screen, and on VDC1
+// sprite 1 as well, as its pause page has no background to hide it:
+//
+   set_sprite_xy(VDC0, 2, 0, 0);
+   set_sprite_xy(VDC0, 3, 0, 0);
+   commit_satb(VDC0);
+
+   if (versus) {
+      set_sprite_xy(VDC1, 1, 0, 0);
+      set_sprite_xy(VDC1, 2, 0, 0);
+      set_sprite_xy(VDC1, 3, 0, 0);
+      commit_satb(VDC1);
    }
-   return(flag);
+
+   wait_joypad_run();
+
+   show_bgpage(bgpage);
 }
 
-void snapshot(int type, int phase, int xpos, int ypos)
+void game_over(void)
 {
-int i, xdelta, ydelta;
+int palette = 0;
+uint32_t pad, trg;
+char *mesg;
+int x, val;
+
+   print_text(VDC0, GAMOVRMSGX+PAGEX(bgpage), GAMOVRMSGY, palette, gameovermsg1, 4);
+   print_text(VDC0, GAMOVRMSGX+PAGEX(bgpage), GAMOVRMSGY+1, palette, gameovermsg2, 4);
+
+   if (replaying) {
+      // the replay must end where the game did, in the same state
+      //
+      if ((play_frame(&play, &pad) == 0) && (game_checksum(&game) == recchecksum))
+         mesg = replayokmsg;
+      else
+         mesg = replayngmsg;
 
-   for (i = 0; i < 4; i++) {
-      xdelta = (piecetbl[(int)type] + phase)->square[i].x;
-      ydelta = (piecetbl[(int)type] + phase)->square[i].y;
-      displn[ypos + ydelta][xpos + xdelta] = (type + 1);
+      print_text(VDC0, REPLAYMSGX+PAGEX(bgpage), REPLAYMSGY, palette, mesg, 9);
    }
+   else if (recvalid) {
+      recvalid    = rec_end(&rec);
+      recchecksum = game_checksum(&game);
+   }
+
+   if (!replaying) {
+      save_clear_game();
+      save_score(game.scoreval, game.levelval);
+   }
+
+   if (numhiscores > 0) {
+      val = hiscores[0].score;
+      for (x = (sizeof(bestmsg) - 2); x >= 5; x--) {
+         bestmsg[x] = '0' + (val % 10);
+         val = val / 10;
+      }
+      print_text(VDC0, BESTMSGX+PAGEX(bgpage), BESTMSGY, palette, bestmsg, sizeof(bestmsg) - 1);
+   }
+
+   trg = wait_joypad_rotation();
+
+   replaying = (recvalid && ((joypad & JOY_SELECT) == JOY_SELECT));
+   versus    = (VS_FITS && !replaying && ((trg & PAD2(JOY_RUN)) != 0));
 }
 
-void testlines(void)
+// A versus match is over: "GAME OVER" on each field whose game ended,
+// and "WINNER" on the other one (if it didn't).  RUN on pad 2 starts
+// another match, and on pad 1 a one-player game.
+//
+void versus_over(int events0, int events1)
 {
-int i, j, k;
-int flg;
+int palette = 0;
+int p, x;
+player *pl;
 
-   for (i = (FIELDHEIGHT+FIELDHIDHT - 1); i > 0; i--) {
-      flg = 0;
+   for (p = 0; p < VS_PLAYERS; p++) {
+      pl = &players[p];
+      x  = pl->fieldx + PAGEX(bgpage);
 
-      for (j = 0; j < FIELDWIDTH; j++) {
-         if (displn[i][j] == 0)
-            flg = 1;
+      if (((p == 0) ? events0 : events1) & GAME_OVER) {
+         print_text(pl->vdc, x + (GAMOVRMSGX - FIELDX), GAMOVRMSGY, palette, gameovermsg1, 4);
+         print_text(pl->vdc, x + (GAMOVRMSGX - FIELDX), GAMOVRMSGY+1, palette, gameovermsg2, 4);
       }
-
-      if (flg != 1) {
-         for (k = i; k > 0; k--) {
-            for (j = 0; j < FIELDWIDTH; j++) {
-               displn[k][j] = displn[k-1][j];
-            }
-         }
-         deletelines++;
-	 i = i + 1;  // the last line will need to be rechecked
+      else {
+         print_text(pl->vdc, x + (WINMSGX - FIELDX), GAMOVRMSGY, palette, winnermsg, 6);
       }
    }
-   while (deletelines > 0) {
-      scoreval[4]++;
-      deletelines--;
-      for (i = 4; i >= 0; i--) {
-         if (scoreval[i] > '9') {
-            scoreval[i] = scoreval[i] - 10;
-            scoreval[i-1]++;
-         }
-      }
+
+   versus = (VS_FITS && ((wait_joypad_rotation() & PAD2(JOY_RUN)) != 0));
+}
+
+// Where each player's field and score go, for this game
+//
+void init_players(void)
+{
+int p;
+player *pl;
+
+   for (p = 0; p < VS_PLAYERS; p++) {
+      pl = &players[p];
+
+      pl->gs     = versus ? &vs.game[p] : &game;
+      pl->vdc    = (p == 0) ? VDC0 : VDC1;
+      pl->fieldx = (p == 0) ? FIELDX : P2FIELDX;
+      pl->scorex = versus ? pl->fieldx : SCOREPOSX;
+      pl->scorey = versus ? VSSCOREY : SCOREPOSY;
+
+      pl->scoredigitval = -1;
    }
-}	
+}
 
-void setsprvars(void)
+void setsprvars(player *pl)
 {
+const gamestate *gs = pl->gs;
 int patterncode;
 int patternctrl;
 int blockptnctrl;
+int x = (gs->pieceposx * 8) + FLD_SPRXORG(pl->fieldx);
 
 
-   patterncode = SPRITE_PATTERN((piecetbl[(int)piecenum] + phasenum)->sprpattern_vram_addr);
-   patternctrl = (SPRITE_Y_HEIGHT_2 | SPRITE_X_WIDTH_2 | SPRITE_PRIO_SP | (piecenum+1) );
+   patterncode = piecemasktbl[PIECEIDX(gs->piecenum, gs->phasenum)].sprpattern;
+   patternctrl = (SPRITE_Y_HEIGHT_2 | SPRITE_X_WIDTH_2 | SPRITE_PRIO_SP | (gs->piecenum+1) );
 
    blockptnctrl = (SPRITE_Y_HEIGHT_2 | SPRITE_X_WIDTH_2 | SPRITE_PRIO_BG | 1 );  // palette doesn't actually matter
 
-   eris_sup_set(VDC0);
-
-// set up sprite 1 as the "invisible block":
+// set up sprite 1 as the "invisible block" (over the lowest 4 hidden
+// rows, where a new piece starts):
 //
-   eris_sup_spr_set(1);
-   eris_sup_spr_create((pieceposx * 8) + FLD_SPRXORG, FLD_SPRYORG, SPRITE_PATTERN(SPR_P7PH0VRAM), blockptnctrl);
+   set_sprite(pl->vdc, 1, x, FLD_SPRYORG + ((FIELDHIDHT - 4) * 8), SPRITE_PATTERN(VRAM_P7PH0), blockptnctrl);
    
 // set up sprite 2 as the "falling block":
 //
-   eris_sup_spr_set(2);
-   eris_sup_spr_create((pieceposx * 8) + FLD_SPRXORG, (pieceposy * 8) + FLD_SPRYORG, patterncode, patternctrl);
+   set_sprite(pl->vdc, 2, x, (gs->pieceposy * 8) + FLD_SPRYORG, patterncode, patternctrl);
+
+// set up sprite 3 as the "ghost" - where the piece would land.  It comes
+// after sprite 2, so the piece is drawn over it when they meet:
+//
+   set_sprite(pl->vdc, 3, x, (gs->ghostposy * 8) + FLD_SPRYORG, patterncode,
+              (SPRITE_Y_HEIGHT_2 | SPRITE_X_WIDTH_2 | SPRITE_PRIO_SP | GHOST_PALETTE));
 }
 
-void dispbkgnd(void)
+// The background's checkerboard tile at (x,y)
+//
+static inline uint16_t bkgnd_ref(int x, int y)
 {
-int x, y;
+   return((((x + y) & 1) == 0) ? bkchr1.ref : bkchr2.ref);
+}
+
+// Fill w tiles at (x,y) on both game pages with tile 'ref'
+//
+static void fill_tiles(VDCNUM vdc, int x, int y, int w, uint16_t ref)
+{
+int i, page;
+uint16_t *row;
+
+   for (page = 0; page < 2; page++) {
+      row = vramq_begin(vdc, ((y + PAGEY(page)) * BGMAPWIDTH) + x + PAGEX(page), w);
+      for (i = 0; i < w; i++)
+         row[i] = ref;
+      vramq_end();
+   }
+}
 
-   eris_low_sup_set_vram_write(VDC0, 0);
+void dispbkgnd(void)
+{
+int x, y, p;
+uint16_t *row;
 
    for (y = 0; y < BGMAPHEIGHT; y++)
    {
+      row = vramq_begin(VDC0, y * BGMAPWIDTH, BGMAPWIDTH);
+
       for (x = 0; x < (BGMAPWIDTH>>1); x++)
       {
          if ((y & 1) ==  0)   // alternating lines
          {
-            eris_low_sup_vram_write(VDC0, bkchr1.ref);
-            eris_low_sup_vram_write(VDC0, bkchr2.ref);
+            *row++ = bkchr1.ref;
+            *row++ = bkchr2.ref;
          } else {
-            eris_low_sup_vram_write(VDC0, bkchr2.ref);
-            eris_low_sup_vram_write(VDC0, bkchr1.ref);
+            *row++ = bkchr2.ref;
+            *row++ = bkchr1.ref;
          }
       }
+      vramq_end();
+   }
+
+   // in versus, VDC1 shows player 2's field and score over VDC0; where
+   // those are colour 0 (empty squares, and around the text), VDC0's
+   // background would show through, so it is left empty there
+   //
+   if (versus) {
+      for (y = FIELDY+FIELDHIDHT; y < (FIELDY+FIELDHIDHT+FIELDHEIGHT); y++)
+         fill_tiles(VDC0, P2FIELDX, y, FIELDWIDTH, offchr.ref);
+      fill_tiles(VDC0, P2FIELDX, VSSCOREY, SCORELEN, offchr.ref);
+   }
+
+   // the playfield area was overwritten too, and so was the score
+   //
+   for (p = 0; p < VS_PLAYERS; p++) {
+      players[p].pagedirty[0] = ALLROWS;
+      players[p].pagedirty[1] = ALLROWS;
+      memset(players[p].hudvalid, 0, sizeof(players[p].hudvalid));
    }
 }
 
-void clear_display_field(void)
+// Clear VDC1's game pages; it is above VDC0 (and all of its tiles are
+// colour 0, so it is transparent) unless this is a versus game.  Then,
+// the hidden rows over player 2's field get VDC0's background tiles, for
+// sprite 1 to be hidden behind (see setsprvars()).
+//
+// VDC0 and VDC1 never both have a visible pixel at the same place (other
+// than the same background tile), so it doesn't matter which of the two
+// Tetsu puts in front.
+//
+void disp_vdc1(void)
 {
-int i, j;
-
-   for (i = 0; i < (FIELDHEIGHT + FIELDHIDHT); i++) {
-      for (j = 0; j < FIELDWIDTH; j++) {
-         displn[i][j] = 0;
+int x, y, page;
+uint16_t *row;
+
+   if (!versus && !vdc1shown)
+      return;
+
+   for (page = 0; page < 2; page++) {
+      for (y = 0; y < 32; y++) {
+         row = vramq_begin(VDC1, ((y + PAGEY(page)) * BGMAPWIDTH) + PAGEX(page), 32);
+
+         for (x = 0; x < 32; x++) {
+            if (versus && (y >= FIELDY) && (y < (FIELDY+FIELDHIDHT)) &&
+                (x >= P2FIELDX) && (x < (P2FIELDX+FIELDWIDTH)))
+               row[x] = bkgnd_ref(x, y);
+            else
+               row[x] = ((CG_FONTLOC) >> 4) + ' ';
+         }
+         vramq_end();
       }
    }
+
+   for (x = 1; x <= 3; x++)
+      set_sprite_xy(VDC1, x, 0, 0);
+   commit_satb(VDC1);
+
+   vdc1shown = versus;
 }
 
+// Compose the pause screen (page BGPAGE_PAUSE):
+// an empty playfield with the PAUSE message over it
+//
 void disp_blank_playfield(void)
 {
 int i, j;
 int addr;
+int palette = 0;
+uint16_t *row;
 
    for (i = FIELDHIDHT; i < (FIELDHIDHT+FIELDHEIGHT); i++)
    {
-      addr = ((i + FIELDY) * BGMAPWIDTH) + FIELDX;
+      addr = ((i + FIELDY + PAGEY(BGPAGE_PAUSE)) * BGMAPWIDTH) + FIELDX + PAGEX(BGPAGE_PAUSE);
 
-      eris_low_sup_set_vram_write(VDC0, addr);
+      row = vramq_begin(VDC0, addr, FIELDWIDTH);
 
       for (j = 0; j < FIELDWIDTH; j++)
       {
-         eris_low_sup_vram_write(VDC0, offchr.ref);
+         row[j] = offchr.ref;
       }
+      vramq_end();
    }
 
-// Move sprite 2 off screen:
-//
-   eris_sup_set(VDC0);
-   eris_sup_spr_set(2);
-   eris_sup_spr_xy(0,0);
+   print_text(VDC0, PAUSEMSGX+PAGEX(BGPAGE_PAUSE), PAUSEMSGY+PAGEY(BGPAGE_PAUSE), palette, pausemsg, 5);
 }
 
-void disp_playfield(void)
+// Draw the player's playfield into the page which isn't being displayed
+//
+void disp_playfield(player *pl)
 {
+gamestate *gs = pl->gs;
 int i, j;
 int addr;
+int page = bgpage ^ 1;
+uint16_t *row;
+
+   // don't start on this page until it is no longer on display
+   //
+   while ((int)(vramq_ctail - bgflipseq) < 0);
+
+   // new changes apply to both game pages
+   //
+   pl->pagedirty[0] |= gs->dirtyrows;
+   pl->pagedirty[1] |= gs->dirtyrows;
+   gs->dirtyrows = 0;
 
    for (i = FIELDHIDHT; i < (FIELDHIDHT+FIELDHEIGHT); i++)
    {
-      addr = ((i + FIELDY) * BGMAPWIDTH) + FIELDX;
+      if ((pl->pagedirty[page] & (1u << i)) == 0)   // unchanged since last drawn
+         continue;
+
+      addr = ((i + FIELDY + PAGEY(page)) * BGMAPWIDTH) + pl->fieldx + PAGEX(page);
 
-      eris_low_sup_set_vram_write(VDC0, addr);
+      row = vramq_begin(pl->vdc, addr, FIELDWIDTH);
 
       for (j = 0; j < FIELDWIDTH; j++)
       {
-         if (displn[i][j] == 0) {
-           eris_low_sup_vram_write(VDC0, offchr.ref);
+         if (gs->displn[i][j] == 0) {
+           row[j] = offchr.ref;
          }
 	 else {
-           eris_low_sup_vram_write(VDC0, (fullchr.ref | (displn[i][j] << 12)) );
+           row[j] = (fullchr.ref | (gs->displn[i][j] << 12));
          }
       }
+      vramq_end();
    }
+   pl->pagedirty[page] = 0;
 }
 
-void display_score(void)
+// A frame's display changes, for the player's game
+//
+void draw_player(player *pl)
 {
-int x;
-char letter;
-uint16_t fontref = 0;
-int palette = 0;
+   setsprvars(pl);
+   commit_satb(pl->vdc);
+   PROF_MARK(PROF_SPRITES);
 
-   eris_low_sup_set_vram_write(VDC0, (SCOREPOSY*BGMAPWIDTH + SCOREPOSX));
+   display_score(pl, bgpage ^ 1);
+   PROF_MARK(PROF_SCORE);
 
-   for (x = 0; x < 7; x++)
-   {
-      letter = *(scoremsg + x);
-      if (letter == 0)
-         break;
+   disp_playfield(pl);
+   PROF_MARK(PROF_FIELD);
+}
 
-      fontref = ((((CG_FONTLOC) >> 4) + letter)  | (palette << 12));
-      eris_low_sup_vram_write(VDC0, fontref);
+// Select the BG page to be displayed, on both chips; as this goes through
+// the VRAM queue, it happens at the vblank in which everything queued
+// before it has been written
+//
+void show_bgpage(int page)
+{
+   vramq_setreg(VDC0, HUC6270_REG_BXR, PAGEX(page) * 8);
+   vramq_setreg(VDC0, HUC6270_REG_BYR, PAGEY(page) * 8);
+   vramq_setreg(VDC1, HUC6270_REG_BXR, PAGEX(page) * 8);
+   vramq_setreg(VDC1, HUC6270_REG_BYR, PAGEY(page) * 8);
+}
+
+// Display the page which was just drawn, and draw into the other one
+//
+void flip_bgpage(void)
+{
+   bgpage ^= 1;
+   show_bgpage(bgpage);
+   bgflipseq = vramq_chead;
+}
+
+// Update the score display on a page, for the player's game; only
+// digits which differ from what that page already shows are written
+//
+void display_score(player *pl, int page)
+{
+int x, first, val;
+uint16_t buf[SCOREDIGITS];
+int palette = 0;
+uint16_t addr;
+
+   if (pl->hudvalid[page] == 0) {
+      print_text(pl->vdc, pl->scorex + PAGEX(page), pl->scorey + PAGEY(page), palette, scoremsg, 7);
+      memset(pl->hudshown[page], 0, SCOREDIGITS);    // no digits there yet
+      pl->hudvalid[page] = 1;
    }
 
-   for (x = 0; x < 6; x++)
-   {
-      letter = *(scoreval + x);
-      if (letter == 0)
-         break;
+   if (pl->scoredigitval != pl->gs->scoreval) {
+      val = pl->gs->scoreval;
+      for (x = (SCOREDIGITS - 1); x >= 0; x--) {
+         pl->scoredigits[x] = '0' + (val % 10);
+         val = val / 10;
+      }
+      pl->scoredigitval = pl->gs->scoreval;
+   }
 
-      fontref = ((((CG_FONTLOC) >> 4) + letter)  | (palette << 12));
-      eris_low_sup_vram_write(VDC0, fontref);
+   addr = ((pl->scorey + PAGEY(page)) * BGMAPWIDTH) + pl->scorex + PAGEX(page) + strlen(scoremsg);
+
+   // write each run of changed digits
+   //
+   first = -1;
+
+   for (x = 0; x <= SCOREDIGITS; x++)
+   {
+      if ((x < SCOREDIGITS) && (pl->hudshown[page][x] != pl->scoredigits[x])) {
+         if (first < 0)
+            first = x;
+         buf[x - first] = ((((CG_FONTLOC) >> 4) + pl->scoredigits[x])  | (palette << 12));
+         pl->hudshown[page][x] = pl->scoredigits[x];
+      }
+      else if (first >= 0) {
+         vramq_write(pl->vdc, addr + first, buf, x - first);
+         first = -1;
+      }
    }
 }
 
 void print_text(VDCNUM vdc, int x_pos, int y_pos, int palette, char *mesg, int maxlen)
 {
-int x;
+int x, len;
 char letter;
 uint16_t fontref = 0;
+uint16_t *buf;
 
-   eris_low_sup_set_vram_write(vdc, (y_pos*BGMAPWIDTH + x_pos));
-   for (x = 0; x < maxlen; x++)
+   for (len = 0; len < maxlen; len++)
    {
-      letter = *(mesg + x);
-      if (letter == 0)
+      if (*(mesg + len) == 0)
          break;
+   }
+
+   buf = vramq_begin(vdc, (y_pos*BGMAPWIDTH + x_pos), len);
+   for (x = 0; x < len; x++)
+   {
+      letter = *(mesg + x);
 
       fontref = ((((CG_FONTLOC) >> 4) + letter)  | (palette << 12));
-      eris_low_sup_vram_write(vdc, fontref);
+      buf[x] = fontref;
    }
+   vramq_end();
 }
 
-void init_score(void)
+// Wait for RUN to resume (PAUSEKEYS); returns the buttons pressed along
+// with it
+//
+uint32_t wait_joypad_run(void)
 {
-   strcpy(scoreval, "00000");
-   scoreval[5] = 0x00;
+uint32_t trg;
+
+   vsync(1);
+
+   while (1)
+   {
+      vsync(0);
+
+      trg = joytrg;
+      if ((trg & PAUSEKEYS) != 0)
+         return(trg);
+   }
 }
 
-void wait_joypad_run(void)
+// At "GAME OVER": wait_joypad_run(), but III on pad 1 switches the
+// rotation system meanwhile; the one in use is shown on player 1's field
+//
+uint32_t wait_joypad_rotation(void)
 {
+player *pl = &players[0];
+int x = pl->fieldx + (ROTMSGX - FIELDX) + PAGEX(bgpage);
+uint32_t trg;
+
+   print_text(pl->vdc, x, ROTMSGY, 0, (rotmode == ROT_KICKS) ? kicksonmsg : kicksoffmsg, 9);
+
    vsync(1);
 
    while (1)
    {
       vsync(0);
 
-      if ((joytrg & JOY_RUN) == JOY_RUN)
-         break;
+      trg = joytrg;
+      if ((trg & JOY_III) != 0) {
+         rotmode = (rotmode == ROT_KICKS) ? ROT_CLASSIC : ROT_KICKS;
+         print_text(pl->vdc, x, ROTMSGY, 0, (rotmode == ROT_KICKS) ? kicksonmsg : kicksoffmsg, 9);
+      }
+      if ((trg & (JOY_RUN | PAD2(JOY_RUN))) != 0)
+         return(trg);
+   }
+}
+
+
+#ifdef PROFILE
+void prof_toggle(void)
+{
+int i, j, page;
+int x, y;
+uint16_t *row;
+
+   if (!PROF_FITS || versus)
+      return;
+
+   profshown ^= 1;
+   profupdate = 0;
+
+   if (profshown)
+      return;
+
+   // put the background back where the readout was
+   //
+   for (page = 0; page < 2; page++) {
+      for (i = 0; i < PROF_TEXTLINES; i++) {
+         x = PROFMSGX + PAGEX(page);
+         y = PROFMSGY + i + PAGEY(page);
+         row = vramq_begin(VDC0, (y * BGMAPWIDTH) + x, PROF_LINELEN);
+
+         for (j = 0; j < PROF_LINELEN; j++)
+            row[j] = bkgnd_ref(x + j, y);
+         vramq_end();
+      }
    }
 }
 
+// Redraw the readout on both game pages, every PROFINTERVAL frames
+//
+void disp_profile(void)
+{
+char buf[PROF_LINELEN];
+int i, page;
+
+   if (!PROF_FITS || (profshown == 0) || versus || (profupdate-- > 0))
+      return;
+
+   profupdate = PROFINTERVAL;
+
+   prof_vramq(vramq_maxdepth, vramq_deferred, vramwrlast);
+
+   for (i = 0; i < PROF_TEXTLINES; i++) {
+      prof_readout(i, buf);
+      for (page = 0; page < 2; page++)
+         print_text(VDC0, PROFMSGX + PAGEX(page), PROFMSGY + i + PAGEY(page), 0, buf, PROF_LINELEN);
+   }
+}
+#endif
 
 void init(void)
 {
-int i, j;
+int i;
 
 //   u32 str[256];
    u16 microprog[16];
-   u16 a, img;
+
+   //
+   //
+   eris_pad_init(0); // initialize joypads (pad 2 is for versus)
+   eris_pad_init(1);
+   pad_reset((eris_pad_read(0) & PAD1MASK) | PAD2(eris_pad_read(1) & PAD1MASK));
+
+   // the timer samples the joypad PAD_SAMPLES times per frame, and is
+   // the clock for timer_now(); it is started first, so that boot is
+   // timed from here
+   //
+   eris_timer_init();
+   eris_timer_set_period(PAD_PERIOD);
+
+
+   // Disable all interrupts before changing handlers.
+   irq_set_mask(0x7F);
+
+   // Replace firmware IRQ handlers for the Timer and HuC6270-A.
+   //
+   // This liberis function uses the V810's hardware IRQ numbering,
+   // see FXGA_GA and FXGABOAD documents for more info ...
+   irq_set_raw_handler(0x9, my_timer_irq);
+   irq_set_raw_handler(0xC, my_vblank_irq);
+
+   // Enable only the Timer interrupt while the VDC is being loaded
+   // (see vram_stream()); HuC6270-A is enabled at the end
+   //
+   // d6=Timer
+   // d5=External
+   // d4=KeyPad
+   // d3=HuC6270-A
+   // d2=HuC6272
+   // d1=HuC6270-B
+   // d0=HuC6273
+   irq_set_mask(0x3F);
+
+   // Allow all IRQs.
+   //
+   // This liberis function uses the V810's hardware IRQ numbering,
+   // see FXGA_GA and FXGABOAD documents for more info ...
+   irq_set_level(8);
+
+   // Enable V810 CPU's interrupt handling.
+   irq_enable();
+
+   eris_timer_start(1);     // (with its interrupt)
 
    eris_sup_init(0, 1);
 //   eris_low_sup_init(0);
@@ -1152,10 +1783,8 @@ int i, j;
 
    // Set up palette entries
    //
-   for (i = 0; i < 128; i++) {
-      eris_tetsu_set_palette(i, CG_palette[i]);
-      eris_tetsu_set_palette(i+256, SPR_palette[i]);
-   }
+   load_palette(0, CG_palette, sizeof(CG_palette) / sizeof(CG_palette[0]));
+   load_palette(256, SPR_palette, sizeof(SPR_palette) / sizeof(SPR_palette[0]));
 
 //   eris_tetsu_set_video_mode(TETSU_LINES_262, 0, TETSU_DOTCLOCK_7MHz, TETSU_COLORS_16,
    eris_tetsu_set_video_mode(TETSU_LINES_262, 0, TETSU_DOTCLOCK_5MHz, TETSU_COLORS_16,
@@ -1167,7 +1796,7 @@ int i, j;
 
    eris_low_sup_set_control(0, 0, 1, 1);
 
-   eris_low_sup_set_access_width(0, 0, SUP_LOW_MAP_64X32, 0, 0);
+   eris_low_sup_set_access_width(0, 0, SUP_LOW_MAP_64X64, 0, 0);
    eris_low_sup_set_scroll(0, 0, 0);
    eris_low_sup_set_video_mode(0, 2, 2, 4, 0x1F, 0x11, 2, 239, 2); // 5MHz numbers
 //   eris_low_sup_set_video_mode(0, 3, 3, 6, 0x2B, 0x11, 2, 239, 2); // 7MHz numbers
@@ -1176,105 +1805,41 @@ int i, j;
    eris_king_set_kram_write(0, 1);
 
    // Clear BG0's RAM
-   for(i = 0; i < 0x1E00; i++) {
-      eris_king_kram_write(0);
-   }
+   kram_fill(0, 0x1E00);
    eris_king_set_kram_write(0, 1);
 
+   // VDC1 is set up the same way, with the same VRAM image, but without
+   // the vblank interrupt; its BG map starts out blank (see disp_vdc1())
    //
-   // load font into video memory
-   // font background/foreground should be subpalettes #0 and #3 respectively
-   //
-   eris_low_sup_set_vram_write(0, 0x1200);
-
-   for(i = 0; i < 0x60; i++) {
-      // first 2 planes of color
-      for (j = 0; j < 8; j++) {
-         img = font[(i*8)+j] & 0xff;
-         a = (img << 8) | img;
-         eris_low_sup_vram_write(0, a);
-      }
-      // last 2 planes of color
-      for (j = 0; j < 8; j++) {
-         eris_low_sup_vram_write(0, 0);
-      }
-   }
-
-   // load CG background gfx into VRAM
-   //
-   load_vram(VDC0, offchr.data,    offchr.vidaddr,    offchr.size);
-   load_vram(VDC0, bkchr1.data,    bkchr1.vidaddr,    bkchr1.size);
-   load_vram(VDC0, bkchr2.data,    bkchr2.vidaddr,    bkchr2.size);
-   load_vram(VDC0, cornerchr.data, cornerchr.vidaddr, cornerchr.size);
-   load_vram(VDC0, endchr.data,    endchr.vidaddr,    endchr.size);
-   load_vram(VDC0, bottomchr.data, bottomchr.vidaddr, bottomchr.size);
-   load_vram(VDC0, fullchr.data,   fullchr.vidaddr,   fullchr.size);
-
-   load_vram(VDC0, p0ph0_data,     SPR_P0PH0VRAM,     sizeof(p0ph0_data));
-   load_vram(VDC0, p0ph1_data,     SPR_P0PH1VRAM,     sizeof(p0ph1_data));
-   load_vram(VDC0, p0ph2_data,     SPR_P0PH2VRAM,     sizeof(p0ph2_data));
-   load_vram(VDC0, p0ph3_data,     SPR_P0PH3VRAM,     sizeof(p0ph3_data));
-
-   load_vram(VDC0, p1ph0_data,     SPR_P1PH0VRAM,     sizeof(p1ph0_data));
-   load_vram(VDC0, p1ph1_data,     SPR_P1PH1VRAM,     sizeof(p1ph1_data));
-   load_vram(VDC0, p1ph2_data,     SPR_P1PH2VRAM,     sizeof(p1ph2_data));
-   load_vram(VDC0, p1ph3_data,     SPR_P1PH3VRAM,     sizeof(p1ph3_data));
-
-   load_vram(VDC0, p2ph0_data,     SPR_P2PH0VRAM,     sizeof(p2ph0_data));
-   load_vram(VDC0, p2ph1_data,     SPR_P2PH1VRAM,     sizeof(p2ph1_data));
-   load_vram(VDC0, p2ph2_data,     SPR_P2PH2VRAM,     sizeof(p2ph2_data));
-   load_vram(VDC0, p2ph3_data,     SPR_P2PH3VRAM,     sizeof(p2ph3_data));
-
-   load_vram(VDC0, p3ph0_data,     SPR_P3PH0VRAM,     sizeof(p3ph0_data));
-   load_vram(VDC0, p3ph1_data,     SPR_P3PH1VRAM,     sizeof(p3ph1_data));
-
-   load_vram(VDC0, p4ph0_data,     SPR_P4PH0VRAM,     sizeof(p4ph0_data));
-   load_vram(VDC0, p4ph1_data,     SPR_P4PH1VRAM,     sizeof(p4ph1_data));
-
-   load_vram(VDC0, p5ph0_data,     SPR_P5PH0VRAM,     sizeof(p5ph0_data));
-   load_vram(VDC0, p5ph1_data,     SPR_P5PH1VRAM,     sizeof(p5ph1_data));
-
-   load_vram(VDC0, p6ph0_data,     SPR_P6PH0VRAM,     sizeof(p6ph0_data));
-
-   load_vram(VDC0, p7ph0_data,     SPR_P7PH0VRAM,     sizeof(p7ph0_data));
+   eris_low_sup_set_control(1, 0, 1, 1);
 
+   eris_low_sup_set_access_width(1, 0, SUP_LOW_MAP_64X64, 0, 0);
+   eris_low_sup_set_scroll(1, 0, 0);
+   eris_low_sup_set_video_mode(1, 2, 2, 4, 0x1F, 0x11, 2, 239, 2); // 5MHz numbers
 
+   // font, tiles and sprites
    //
-   //
-   eris_pad_init(0); // initialize joypad
+   load_vram_image(VDC0);
+   load_vram_image(VDC1);
 
+   vram_stream(VDC1, VRAM_BAT);
+   for (i = 0; i < (BGMAPWIDTH * BGMAPHEIGHT); i++)
+      out16(VDC_DATA(VDC1), ((CG_FONTLOC) >> 4) + ' ');
 
-   // Disable all interrupts before changing handlers.
-   irq_set_mask(0x7F);
+   init_satb();
 
-   // Replace firmware IRQ handlers for the Timer and HuC6270-A.
-   //
-   // This liberis function uses the V810's hardware IRQ numbering,
-   // see FXGA_GA and FXGABOAD documents for more info ...
-   irq_set_raw_handler(0xC, my_vblank_irq);
 
    // Enable Timer and HuC6270-A interrupts.
    //
-   // d6=Timer
-   // d5=External
-   // d4=KeyPad
-   // d3=HuC6270-A
-   // d2=HuC6272
-   // d1=HuC6270-B
-   // d0=HuC6273
-   irq_set_mask(0x77);
-
-   // Allow all IRQs.
-   //
-   // This liberis function uses the V810's hardware IRQ numbering,
-   // see FXGA_GA and FXGABOAD documents for more info ...
-   irq_set_level(8);
-
-   // Enable V810 CPU's interrupt handling.
-   irq_enable();
+   irq_set_mask(0x37);
 
    eris_low_sup_setreg(VDC0, 5, 0xC8);  // Set Hu6270 BG to show, and VSYNC Interrupt
+   eris_low_sup_setreg(VDC1, 5, 0xC0);  // (VDC1: BG and sprites, no interrupt)
 
    eris_bkupmem_set_access(1,1);
+
+#ifdef PROFILE
+   prof_init();
+#endif
 }
 
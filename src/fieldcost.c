@@ -0,0 +1,246 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// fieldcost - what the game rules' field operations cost, for the field
+//             size this is built with
+//
+// usage:
+//   blox-fieldcost [-h] [seconds]
+//
+// The field size is fixed at build time (see game.h), so this is built
+// once for each size to be compared: "make fieldcost" builds and runs it
+// for each of FIELDSIZES, as one table.  -h prints the table's header;
+// seconds (default 3) is split between the three timings.
+//
+// Boards are made up of random rows (each square filled with a chance of
+// 0.6, and never a full row), up to a random height of at most 3/4 of the
+// field.  On each of them:
+//   collision  chkmvok() for every piece and phase, at every row, from a
+//              column off the left edge to one off the right (so a mix of
+//              collisions, edges and fits)
+//   lock       landing_row() and snapshot(): a random piece coming to
+//              rest, as game_frame() does it
+//   clear      testlines(), once a piece has been locked into a gap left
+//              for it, completing each of its rows (1 to 4 lines)
+// Lock and clear change the board, so they are timed on a copy of it,
+// less the time taken to make the copy.
+//
+// Also reported: the size of a gamestate (a versus match holds two).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "hosttest.h"
+
+#define BOARDS           256
+#define BOARDROWS        (FIELDHEIGHT+FIELDHIDHT)
+
+typedef struct placements
+{
+   int      type;
+   int      phase;
+   int      x;
+   int      y;
+} placement;
+
+static gamestate  boards[BOARDS];       // for collision and lock
+static placement  drops[BOARDS];
+static gamestate  locked[BOARDS];       // for clear: drops[b] locked into a gap
+
+gamestate work;         // (not static, so that copying to it is never left out)
+
+static volatile uint32_t sink;          // (so that nothing is optimised away)
+
+static void set_square(gamestate *gs, int row, int col, int colour)
+{
+   gs->dispmask[row]   |= FIELDBIT(col);
+   gs->displn[row][col] = colour;
+   gs->rowfill[row]++;
+   gs->coltop[col]      = MIN(gs->coltop[col], row);
+}
+
+static void make_board(gamestate *gs)
+{
+int i, j, top;
+
+   game_start(gs, lcg_next(0xFFFFFFFF));
+
+   top = BOARDROWS - lcg_next(((FIELDHEIGHT * 3) / 4) + 1);
+
+   for (i = BOARDROWS - 1; i >= top; i--) {
+      for (j = 0; j < FIELDWIDTH; j++)
+         if (lcg_next(10) < 6)
+            set_square(gs, i, j, 1 + lcg_next(NUMPIECES));
+
+      if (gs->rowfill[i] == FIELDWIDTH) {
+         j = lcg_next(FIELDWIDTH);
+         gs->dispmask[i] &= ~FIELDBIT(j);
+         gs->displn[i][j] = 0;
+         gs->rowfill[i]--;
+      }
+   }
+
+   // (the column tops, from scratch: a square taken out above may have
+   // been one)
+   //
+   for (j = 0; j < FIELDWIDTH; j++)
+      for (gs->coltop[j] = 0; (gs->dispmask[gs->coltop[j]] & FIELDBIT(j)) == 0; gs->coltop[j]++)
+         ;
+}
+
+// Fill every square of the drop's rows that the piece doesn't cover, so
+// that locking it completes them all
+//
+static void make_gap(gamestate *gs, const placement *drop)
+{
+const piecemask *pm = &piecemasktbl[PIECEIDX(drop->type, drop->phase)];
+fieldrow piece;
+int i, j;
+
+   for (i = 0; i < pm->height; i++) {
+      piece = (fieldrow)pm->rowmask[i] << drop->x;
+      for (j = 0; j < FIELDWIDTH; j++)
+         if (((gs->dispmask[drop->y + i] | piece) & FIELDBIT(j)) == 0)
+            set_square(gs, drop->y + i, j, 1 + lcg_next(NUMPIECES));
+   }
+}
+
+static double time_collision(double seconds, long *calls)
+{
+double start, elapsed;
+uint32_t hits = 0;
+int b, type, phase, x, y;
+
+   *calls = 0;
+   start  = now_sec();
+
+   do {
+      for (b = 0; b < BOARDS; b++)
+         for (type = 0; type < NUMPIECES; type++)
+            for (phase = 0; phase < NUMPHASES; phase++)
+               for (y = 0; y < BOARDROWS; y++)
+                  for (x = -1; x <= FIELDWIDTH; x++)
+                     hits += chkmvok(&boards[b], type, phase, x, y, 0, 0);
+
+      *calls += (long)BOARDS * NUMPIECES * NUMPHASES * BOARDROWS * (FIELDWIDTH + 2);
+      elapsed = now_sec() - start;
+   } while (elapsed < seconds);
+
+   sink = hits;
+   return(elapsed);
+}
+
+static void op_none(gamestate *gs, const placement *drop)
+{
+   sink += gs->dirtyrows;
+}
+
+static void op_lock(gamestate *gs, const placement *drop)
+{
+int y;
+
+   y = landing_row(gs, drop->type, drop->phase, drop->x, 0);
+   snapshot(gs, drop->type, drop->phase, drop->x, y);
+   sink += y;
+}
+
+static void op_clear(gamestate *gs, const placement *drop)
+{
+   sink += testlines(gs);
+}
+
+static double time_copies(const gamestate *from, void (*op)(gamestate *gs, const placement *drop), long passes)
+{
+double start;
+long n;
+int b;
+
+   start = now_sec();
+   for (n = 0; n < passes; n++) {
+      for (b = 0; b < BOARDS; b++) {
+         work = from[b];
+         op(&work, &drops[b]);
+      }
+   }
+   return(now_sec() - start);
+}
+
+// Time op() on a copy of each board, and the same with op_none(); returns
+// the difference, per call, in seconds
+//
+static double time_on_copy(const gamestate *from, void (*op)(gamestate *gs, const placement *drop), double seconds)
+{
+double elapsed;
+long passes;
+
+   for (passes = 1; (elapsed = time_copies(from, op, passes)) < (seconds / 2); passes *= 2)
+      ;
+
+   return((elapsed - time_copies(from, op_none, passes)) / ((double)passes * BOARDS));
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage:\n    blox-fieldcost [-h] [seconds]\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+const piecemask *pm;
+placement *drop;
+double seconds = 3.0;
+double collision, lock, clear, elapsed;
+long calls, lines = 0;
+int b;
+
+   if (argc > 2)
+      usage();
+   if (argc == 2) {
+      if (strcmp(argv[1], "-h") == 0) {
+         printf("%-5s   %6s   %9s   %8s   %8s   %s\n", "field", "bytes", "collision", "lock", "clear", "lines");
+         printf("%-5s   %6s   %9s   %8s   %8s   %s\n", "", "", "ns/test", "ns/piece", "ns/clear", "/clear");
+         return(0);
+      }
+      seconds = atof(argv[1]);
+      if (seconds <= 0)
+         usage();
+   }
+
+   for (b = 0; b < BOARDS; b++) {
+      make_board(&boards[b]);
+
+      // a drop which lands in the field (not the hidden rows), on each
+      //
+      drop = &drops[b];
+      do {
+         drop->type  = lcg_next(NUMPIECES);
+         drop->phase = lcg_next(NUMPHASES);
+         pm = &piecemasktbl[PIECEIDX(drop->type, drop->phase)];
+         drop->x     = lcg_next(FIELDWIDTH - pm->width + 1);
+         drop->y     = landing_row(&boards[b], drop->type, drop->phase, drop->x, 0);
+      } while (drop->y < FIELDHIDHT);
+
+      locked[b] = boards[b];
+      make_gap(&locked[b], drop);
+      snapshot(&locked[b], drop->type, drop->phase, drop->x, drop->y);
+      lines += pm->height;
+   }
+
+   elapsed   = time_collision(seconds / 3, &calls);
+   collision = elapsed / calls;
+   lock      = time_on_copy(boards, op_lock, seconds / 3);
+   clear     = time_on_copy(locked, op_clear, seconds / 3);
+
+   printf("%2dx%-2d   %6d   %9.2f   %8.1f   %8.1f   %.2f\n",
+          FIELDWIDTH, FIELDHEIGHT, (int)sizeof(gamestate),
+          collision * 1e9, lock * 1e9, clear * 1e9, (double)lines / BOARDS);
+
+   return(0);
+}
@@ -1,4 +1,4 @@
-# 8x8 monochrome font(s)
+# 8x8 monochrome font(s) - converted by mkassets (see assets.txt)
 
 	.global _font
 
@@ -0,0 +1,654 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Game rules (see game.h)
+//
+
+#include <string.h>
+
+#include "game.h"
+
+// Piece orientation information lives in piecedata.h; it is converted
+// at build time (by mkpiecetbl) into the flat piecemasktbl[]:
+//
+#include "piecetbl.gen_data"
+
+
+const chlng_level diff_level[] = {
+   { 30, 4 },
+   { 24, 9 },
+   { 20, 14 },
+   { 16, 19 },
+   { 12, 29 },
+   { 10, 39 },
+   { 8, 49 },
+   { 6, 59 },
+   { 5, 69 },
+   { 4, 79 },
+   { 3, 99 },
+   { 2, 119 },
+   { 1, SCOREMAX }
+};
+
+const int diff_numlevels = (int)(sizeof(diff_level) / sizeof(chlng_level));
+
+#if (NEXTPIECES & (NEXTPIECES - 1)) != 0
+#error NEXTPIECES must be a power of 2
+#endif
+
+
+// The seed is scrambled first (with the "fmix" step of MurmurHash3):
+// xorshift is linear, so nearby seeds - such as frame counts - would
+// otherwise start out with related sequences
+//
+void rng_seed(gamestate *gs, uint32_t seed)
+{
+uint32_t x = seed + 0x9E3779B9;
+
+   x ^= x >> 16;
+   x *= 0x85EBCA6B;
+   x ^= x >> 13;
+   x *= 0xC2B2AE35;
+   x ^= x >> 16;
+
+   if (x == 0)                 // (the one state xorshift can't leave)
+      x = 1;
+   gs->rngstate = x;
+}
+
+uint32_t rng_next(gamestate *gs)
+{
+uint32_t x = gs->rngstate;
+
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   gs->rngstate = x;
+   return(x);
+}
+
+// A number from 0 to (range - 1), for range up to 65536; scaled with a
+// multiply and shift rather than a divide
+//
+int rng_range(gamestate *gs, int range)
+{
+   return(((rng_next(gs) >> 16) * range) >> 16);
+}
+
+// Deal the next piece from the bag, shuffling a new bag when it is empty
+//
+static int bag_draw(gamestate *gs)
+{
+int i, j, tmp;
+
+   if (gs->bagleft == 0) {
+      for (i = 0; i < NUMPIECES; i++)
+         gs->bag[i] = i;
+
+      for (i = NUMPIECES - 1; i > 0; i--) {    // Fisher-Yates
+         j = rng_range(gs, i + 1);
+         tmp        = gs->bag[i];
+         gs->bag[i] = gs->bag[j];
+         gs->bag[j] = tmp;
+      }
+      gs->bagleft = NUMPIECES;
+   }
+
+   return(gs->bag[--gs->bagleft]);
+}
+
+// Take the next piece from the lookahead ring, and refill it
+//
+static int next_take(gamestate *gs)
+{
+int piece = gs->nextq[gs->nextpos];
+
+   gs->nextq[gs->nextpos] = bag_draw(gs);
+   gs->nextpos = (gs->nextpos + 1) & (NEXTPIECES - 1);
+   return(piece);
+}
+
+// The piece which will come n pieces after the current one (n = 1 is the
+// next one), for n up to NEXTPIECES
+//
+int game_peek(const gamestate *gs, int n)
+{
+   return(gs->nextq[(gs->nextpos + n - 1) & (NEXTPIECES - 1)]);
+}
+
+// Give a gamestate which starts out zeroed diff_level, if it has no
+// difficulty table yet (both game_start() and load_game() need one)
+//
+void game_default_levels(gamestate *gs)
+{
+   if (gs->difftbl == NULL)
+      game_set_levels(gs, diff_level, diff_numlevels);
+}
+
+// Set up a new game; everything after this (pieces included) follows
+// from the seed and the joypad input.  The difficulty table is kept from
+// game_set_levels(), and the rotation system from game_set_rotation(); a
+// gamestate which starts out zeroed gets diff_level and ROT_CLASSIC.
+//
+void game_start(gamestate *gs, uint32_t seed)
+{
+int i;
+
+   game_default_levels(gs);
+
+   init_score(gs);
+
+   // nothing carries over from the last game (so that a recorded game
+   // replays the same way)
+   //
+   memset(gs->joyrptstate, 0, sizeof(gs->joyrptstate));
+   gs->joyout = 0;
+
+   clear_display_field(gs);
+
+   // set initial difficulty level
+   //
+   gs->levelval   = 0;
+   gs->frampermov = gs->difftbl[gs->levelval].vsyncs;
+
+   rng_seed(gs, seed);
+   gs->bagleft = 0;
+   gs->nextpos = 0;
+   for (i = 0; i < NEXTPIECES; i++)
+      gs->nextq[i] = bag_draw(gs);
+
+   gs->piecenum  = next_take(gs);
+
+   setpiece(gs);
+   gs->ghostposy = landing_row(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy);
+
+   // set countdown interval - number of frames until piece moves downward
+   //
+   gs->fpmcount = gs->frampermov;
+}
+
+// Use a different difficulty table (for trying out new ones); takes
+// effect at the next game_start()
+//
+void game_set_levels(gamestate *gs, const chlng_level *tbl, int count)
+{
+   gs->difftbl   = tbl;
+   gs->numlevels = count;
+}
+
+// Choose the rotation system (ROT_CLASSIC or ROT_KICKS); it is kept from
+// game to game.  A recorded game only plays back the same way with the
+// system it was recorded with.
+//
+void game_set_rotation(gamestate *gs, int mode)
+{
+   gs->rotmode = mode;
+}
+
+// Run the game for one frame, given the joypad state for the frame;
+// returns a combination of the GAME_xxx bits
+//
+int game_frame(gamestate *gs, uint32_t pad)
+{
+int events = 0;
+int oldx = gs->pieceposx;
+int oldphase = gs->phasenum;
+
+   sensejoy(gs, pad);   // figure out joypad auto-repeat
+   joypadmv(gs);        // move
+
+   gs->joyout = 0;      // reset
+
+   PROF_MARK(PROF_INPUT);
+
+   gs->fpmcount--;      // is it time to move pice down ?
+
+   if (gs->fpmcount == 0) {
+
+      // check if score exceeds threshold to increase difficulty
+      if ((gs->scoreval >= gs->difftbl[gs->levelval].score) && (gs->levelval < (gs->numlevels - 1))) {
+         gs->levelval++;
+         gs->frampermov = gs->difftbl[gs->levelval].vsyncs;
+         events |= GAME_LEVELUP;
+      }
+
+      gs->fpmcount = gs->frampermov;     // reset down-counter
+
+      // move pirce downward (if possible)
+      if (chkmvok(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy, 0, 1) == 0) {
+         gs->pieceposy++;
+      }
+      else {
+         // transfer to background
+         snapshot(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy);
+         events |= GAME_LOCKED;
+
+         // check if any part is still in the 'hidden' area at the top
+         // if so, "game over"
+         if (gs->pieceposy < FIELDHIDHT) {     // are any of the current piece's squares in the hidden area ?
+            events |= GAME_OVER;              // yes, it's game_over
+         }
+         else {
+            PROF_MARK(PROF_GRAVITY);
+            if (testlines(gs) != 0)  // delete complete lines & add score
+               events |= GAME_LINES;
+            PROF_MARK(PROF_LINES);
+            nxtpiece(gs);            // set next piece
+         }
+      }
+   }
+
+   // the landing row only changes when the piece moves across or turns,
+   // or the board changes (falling doesn't change it)
+   //
+   if ((gs->pieceposx != oldx) || (gs->phasenum != oldphase) || (events & GAME_LOCKED))
+      gs->ghostposy = landing_row(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy);
+
+   PROF_MARK(PROF_GRAVITY);
+
+   return(events);
+}
+
+// Auto-repeat: each button in JOYRPTMASK has its own state, so holding
+// one doesn't hold up (or restart) the repeat of another.  A button gives
+// a move when it is pressed, again after JOYRPTINIT+JOYRPTSUBS+1 frames,
+// and every JOYRPTSUBS+1 frames after that.  Buttons in JOYONCEMASK only
+// give a move when they are pressed (their count stays at 0).
+//
+void sensejoy(gamestate *gs, uint32_t pad)
+{
+int i;
+joyrpt *jr;
+
+   for (i = 0; i < JOYBUTTONS; i++) {
+      if (((JOYRPTMASK | JOYONCEMASK) & (1 << i)) == 0)
+         continue;
+
+      jr = &gs->joyrptstate[i];
+
+      if ((pad & (1 << i)) == 0) {
+         jr->state = JOYST_UP;
+         continue;
+      }
+
+      switch (jr->state) {
+      case JOYST_UP:
+         gs->joyout |= (1 << i);
+         jr->state   = JOYST_HELD;
+         jr->count   = (JOYONCEMASK & (1 << i)) ? 0 : (JOYRPTINIT + JOYRPTSUBS + 1);
+         break;
+
+      case JOYST_HELD:
+      case JOYST_RPT:
+         // (which buttons are once-only is fixed per i)
+         //
+         if (JOYONCEMASK & (1 << i))
+            break;
+
+         if (--jr->count == 0) {
+            gs->joyout |= (1 << i);
+            jr->state   = JOYST_RPT;
+            jr->count   = JOYRPTSUBS + 1;
+         }
+         break;
+      }
+   }
+}
+
+// Rotate the piece, if it can be
+//
+static void rotate(gamestate *gs, int dir)
+{
+int x = gs->pieceposx;
+int y = gs->pieceposy;
+int phase;
+
+   // (falling only takes it down, so the lowest it has been is here, or
+   // somewhere it was rotated from)
+   //
+   gs->piecelow = MAX(gs->piecelow, y + piecemasktbl[PIECEIDX(gs->piecenum, gs->phasenum)].height - 1);
+
+   phase = rotate_to(gs, gs->piecenum, gs->phasenum, dir, &x, &y);
+   if (phase >= 0) {
+      gs->phasenum  = phase;
+      gs->pieceposx = x;
+      gs->pieceposy = y;
+   }
+}
+
+void joypadmv(gamestate *gs)
+{
+
+   if ((gs->joyout & JOY_LEFT) == JOY_LEFT)
+      if (chkmvok(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy, -1, 0) == 0)
+         gs->pieceposx--;
+
+   if ((gs->joyout & JOY_RIGHT) == JOY_RIGHT)
+      if (chkmvok(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy, 1, 0) == 0)
+         gs->pieceposx++;
+
+   if ((gs->joyout & JOY_DOWN) == JOY_DOWN) {
+      if (chkmvok(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy, 0, 1) == 0)
+         gs->pieceposy++;
+   }
+
+   if ((gs->joyout & JOY_I) == JOY_I)
+      rotate(gs, ROT_NEXT);
+
+   if ((gs->joyout & JOY_II) == JOY_II)
+      rotate(gs, ROT_PREV);
+
+   // hard drop: straight down, and it locks this frame
+   //
+   if ((gs->joyout & JOY_UP) == JOY_UP) {
+      gs->pieceposy = landing_row(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy);
+      gs->fpmcount  = 1;
+   }
+
+//   if ((joytrg & JOY_III) == JOY_III) {
+//      if (piecenum == 6)
+//         piecenum = 0;
+//      else
+//         piecenum++;
+//   }
+//
+//   if ((joytrg & JOY_IV) == JOY_IV) {
+//      if (piecenum == 0)
+//         piecenum = 6;
+//      else
+//         piecenum--;
+//   }
+}
+
+void nxtpiece(gamestate *gs)
+{
+   gs->piecenum = next_take(gs);
+   setpiece(gs);
+}
+
+void setpiece(gamestate *gs)
+{
+const piecemask *pm;
+
+   gs->phasenum  = 0;
+   pm = &piecemasktbl[PIECEIDX(gs->piecenum, gs->phasenum)];
+   gs->pieceposy = FIELDHIDHT - pm->height;
+   gs->pieceposx = (FIELDWIDTH - pm->width) >> 1;
+   gs->piecelow  = FIELDHIDHT - 1;
+}
+
+int chkmvok(const gamestate *gs, int type, int phase, int xpos, int ypos, int xdelta, int ydelta)
+{
+const piecemask *pm = &piecemasktbl[PIECEIDX(type, phase)];
+const fieldrow *row;
+
+   xpos += xdelta;
+   ypos += ydelta;
+
+   // Check whether movement would put it out of bounds
+   // (the bottom edge is taken care of by the solid floor rows):
+   //
+   if ((xpos < 0) || (xpos > (FIELDWIDTH - pm->width)) || (ypos < 0))
+      return(1);
+
+   // Check whether movement would have it collide with terrain:
+   //
+   row = &gs->dispmask[ypos];
+
+   return(((row[0] & ((fieldrow)pm->rowmask[0] << xpos)) |
+           (row[1] & ((fieldrow)pm->rowmask[1] << xpos)) |
+           (row[2] & ((fieldrow)pm->rowmask[2] << xpos)) |
+           (row[3] & ((fieldrow)pm->rowmask[3] << xpos))) != 0);
+}
+
+// Rotate a piece from phase at (*xpos, *ypos), in direction dir (ROT_NEXT
+// or ROT_PREV); returns the new phase, and moves (*xpos, *ypos) to where
+// it went, or returns -1 if it can't be rotated.  Classic rotation tries
+// only the new phase's own offset; with kicks, the rest of the piece's
+// kicks are tried in turn (so at most KICKMAX mask tests), and the first
+// one that fits is taken.
+//
+// A kick which lifts the piece (above where classic rotation would put
+// it) is only taken if the piece's bottom stays at or below the lowest
+// row it has reached (piecelow, or where it is now).  Otherwise a piece
+// could climb the stack by rotating against it, or stay up forever.
+//
+int rotate_to(const gamestate *gs, int type, int phase, int dir, int *xpos, int *ypos)
+{
+const rotkick *rk = &rotkicktbl[KICKIDX(type, phase, dir)];
+const piecemask *to;
+int count = (gs->rotmode == ROT_KICKS) ? rk->count : 1;
+int i, low;
+
+   low   = MAX(gs->piecelow, *ypos + piecemasktbl[PIECEIDX(type, phase)].height - 1);
+   phase = (phase + ((dir == ROT_NEXT) ? 1 : 3)) & 3;
+   to    = &piecemasktbl[PIECEIDX(type, phase)];
+
+   for (i = 0; i < count; i++) {
+      if ((rk->dy[i] < to->roty) && ((*ypos + rk->dy[i] + to->height - 1) < low))
+         continue;
+      if (chkmvok(gs, type, phase, *xpos, *ypos, rk->dx[i], rk->dy[i]) == 0) {
+         *xpos += rk->dx[i];
+         *ypos += rk->dy[i];
+         return(phase);
+      }
+   }
+   return(-1);
+}
+
+// The row at which the piece would come to rest, dropped straight down
+// from (xpos, ypos).  Nothing is above the top of any column, so this is
+// the lowest the piece can go over each of its columns - unless it has
+// been slid in under an overhang (below the top of one of its columns),
+// when it has to be stepped down row by row.
+//
+int landing_row(const gamestate *gs, int type, int phase, int xpos, int ypos)
+{
+const piecemask *pm = &piecemasktbl[PIECEIDX(type, phase)];
+int j, y;
+int land = FIELDHEIGHT + FIELDHIDHT;
+
+   for (j = 0; j < pm->width; j++) {
+      y = gs->coltop[xpos + j] - pm->bottom[j];
+      land = MIN(land, y);
+   }
+
+   if (land >= ypos)
+      return(land);
+
+   while (chkmvok(gs, type, phase, xpos, ypos, 0, 1) == 0)
+      ypos++;
+   return(ypos);
+}
+
+void snapshot(gamestate *gs, int type, int phase, int xpos, int ypos)
+{
+const piecemask *pm = &piecemasktbl[PIECEIDX(type, phase)];
+int i, j;
+
+   gs->dirtyrows |= (((1u << pm->height) - 1) << ypos);
+
+   for (i = 0; i < pm->height; i++) {
+      gs->dispmask[ypos + i] |= ((fieldrow)pm->rowmask[i] << xpos);
+
+      for (j = 0; j < pm->width; j++) {
+         if (pm->rowmask[i] & (1 << j)) {
+            gs->displn[ypos + i][xpos + j] = (type + 1);
+            gs->rowfill[ypos + i]++;
+            gs->coltop[xpos + j] = MIN(gs->coltop[xpos + j], ypos + i);
+         }
+      }
+   }
+}
+
+// Remove complete lines & add score; returns the # of lines removed
+// (listed in clearedrow[], and kept in linescleared).
+//
+// This is a single pass from the bottom up: each remaining row is moved
+// down (at most once) past the complete rows found below it so far.
+//
+int testlines(gamestate *gs)
+{
+int i, j, dst;
+int count = 0;
+
+   dst = (FIELDHEIGHT+FIELDHIDHT - 1);
+
+   for (i = dst; i >= 0; i--) {
+      if (gs->rowfill[i] == FIELDWIDTH) {
+         gs->clearedrow[count++] = i;
+         continue;
+      }
+
+      if (dst != i) {
+         gs->dispmask[dst] = gs->dispmask[i];
+         gs->rowfill[dst]  = gs->rowfill[i];
+         memcpy(gs->displn[dst], gs->displn[i], FIELDWIDTH);
+      }
+      dst--;
+   }
+
+   gs->linescleared = count;
+   if (count == 0)
+      return(0);
+
+   // the rows at the top are now empty
+   //
+   for (i = dst; i >= 0; i--) {
+      gs->dispmask[i] = 0;
+      gs->rowfill[i]  = 0;
+      memset(gs->displn[i], 0, FIELDWIDTH);
+   }
+
+   gs->dirtyrows |= ((2u << gs->clearedrow[0]) - 1);   // everything above the lowest cleared row moved
+
+   // every removed row was full, so was at or below each column's top:
+   // the rows above the top all moved down by count.  If the top square
+   // itself was removed, the new top is further down (the floor rows stop
+   // the search).
+   //
+   for (j = 0; j < FIELDWIDTH; j++) {
+      i = gs->coltop[j] + count;
+      while ((gs->dispmask[i] & FIELDBIT(j)) == 0)
+         i++;
+      gs->coltop[j] = i;
+   }
+
+   gs->scoreval = MIN(gs->scoreval + count, SCOREMAX);
+
+   return(count);
+}
+
+// Push garbage up from the bottom of the field (versus): lines rows, full
+// but for the hole column.  Returns GAME_OVER if that would push squares
+// off the top, or if the piece can't be moved up clear of the stack.
+//
+int game_garbage(gamestate *gs, int lines, int hole)
+{
+int i, j;
+
+   for (i = 0; i < lines; i++)
+      if (gs->dispmask[i] != 0)
+         return(GAME_OVER);
+
+   memmove(&gs->dispmask[0], &gs->dispmask[lines], (FIELDHEIGHT+FIELDHIDHT - lines) * sizeof(gs->dispmask[0]));
+   memmove(&gs->rowfill[0], &gs->rowfill[lines], (FIELDHEIGHT+FIELDHIDHT - lines) * sizeof(gs->rowfill[0]));
+   memmove(&gs->displn[0], &gs->displn[lines], (FIELDHEIGHT+FIELDHIDHT - lines) * sizeof(gs->displn[0]));
+
+   for (i = (FIELDHEIGHT+FIELDHIDHT - lines); i < (FIELDHEIGHT+FIELDHIDHT); i++) {
+      gs->dispmask[i] = FIELDFULLMASK & ~FIELDBIT(hole);
+      gs->rowfill[i]  = FIELDWIDTH - 1;
+      memset(gs->displn[i], GARBAGECOLOUR, FIELDWIDTH);
+      gs->displn[i][hole] = 0;
+   }
+
+   // everything moved up by lines; the hole column's top may now be
+   // below the garbage (the floor rows stop the search)
+   //
+   for (j = 0; j < FIELDWIDTH; j++) {
+      i = gs->coltop[j] - lines;
+      while ((gs->dispmask[i] & FIELDBIT(j)) == 0)
+         i++;
+      gs->coltop[j] = i;
+   }
+
+   gs->dirtyrows = ALLROWS;
+
+   while (chkmvok(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy, 0, 0) != 0) {
+      if (gs->pieceposy == 0)
+         return(GAME_OVER);
+      gs->pieceposy--;
+   }
+
+   // (the piece has only just been set, so its lowest row moves up too)
+   //
+   gs->piecelow = MIN(gs->piecelow, gs->pieceposy + piecemasktbl[PIECEIDX(gs->piecenum, gs->phasenum)].height - 1);
+
+   gs->ghostposy = landing_row(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy);
+
+   return(0);
+}
+
+void clear_display_field(gamestate *gs)
+{
+int i;
+
+   memset(gs->dispmask, 0, sizeof(gs->dispmask));
+   memset(gs->displn, 0, sizeof(gs->displn));
+   memset(gs->rowfill, 0, sizeof(gs->rowfill));
+   memset(gs->coltop, FIELDHEIGHT + FIELDHIDHT, sizeof(gs->coltop));
+
+   for (i = (FIELDHEIGHT + FIELDHIDHT); i < (FIELDHEIGHT + FIELDHIDHT + FIELDFLOOR); i++)
+      gs->dispmask[i] = FIELDFULLMASK;
+
+   gs->linescleared = 0;
+   gs->dirtyrows    = ALLROWS;
+}
+
+void init_score(gamestate *gs)
+{
+   gs->scoreval = 0;
+}
+
+// FNV-1a, one value at a time (so it doesn't depend on byte order)
+//
+static uint32_t chksum_add(uint32_t sum, uint32_t val)
+{
+   sum = (sum ^ val) * 16777619;
+   return(sum);
+}
+
+// Checksum of the whole game state; two runs which played the same way
+// end up with the same value
+//
+uint32_t game_checksum(const gamestate *gs)
+{
+uint32_t sum = 2166136261u;
+int i, j;
+
+   for (i = 0; i < (FIELDHEIGHT+FIELDHIDHT); i++) {
+      sum = chksum_add(sum, gs->dispmask[i]);
+      sum = chksum_add(sum, gs->rowfill[i]);
+      for (j = 0; j < FIELDWIDTH; j++)
+         sum = chksum_add(sum, gs->displn[i][j]);
+   }
+
+   sum = chksum_add(sum, gs->piecenum);
+   sum = chksum_add(sum, gs->phasenum);
+   sum = chksum_add(sum, gs->pieceposx);
+   sum = chksum_add(sum, gs->pieceposy);
+   sum = chksum_add(sum, gs->scoreval);
+   sum = chksum_add(sum, gs->levelval);
+   sum = chksum_add(sum, gs->fpmcount);
+   for (i = 0; i < JOYBUTTONS; i++)
+      sum = chksum_add(sum, (gs->joyrptstate[i].state << 8) | gs->joyrptstate[i].count);
+   sum = chksum_add(sum, gs->rngstate);
+   sum = chksum_add(sum, gs->bagleft);
+   for (i = 0; i < NEXTPIECES; i++)
+      sum = chksum_add(sum, game_peek(gs, i + 1));
+
+   return(sum);
+}
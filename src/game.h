@@ -0,0 +1,282 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Game rules - the portable part of the game
+//
+// Nothing in here touches the hardware, so it builds with the PC-FX
+// compiler (as part of the game) and with the host compiler (for the
+// benchmark and other tools).
+//
+// Platform interface:
+//   the platform calls game_start(gs, seed) at the beginning of each game,
+//   and game_frame() once per frame with that frame's joypad state; the
+//   return value says what happened during the frame.  The platform draws
+//   from the gamestate (dispmask/displn, piece and ghost position,
+//   scoreval), and clears dirtyrows once it has redrawn those rows.
+//
+// Everything about a game is in its gamestate, which every function here
+// is given; there is no other state.  So any number of games can be
+// played at once (on any number of threads), and a game can be copied
+// (by assignment) to try things out on.
+//
+
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+
+#include "pieces.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// # of bits set (for the row masks)
+//
+static inline int popcount32(uint32_t val)
+{
+int count = 0;
+
+   while (val) {
+      val &= (val - 1);
+      count++;
+   }
+   return(count);
+}
+
+// Joypad defines (move these to library includes)
+//
+#define JOY_I            1
+#define JOY_II           2
+#define JOY_III          4
+#define JOY_IV           8
+#define JOY_V            16
+#define JOY_VI           32
+#define JOY_SELECT       64
+#define JOY_RUN          128
+#define JOY_UP           256
+#define JOY_RIGHT        512
+#define JOY_DOWN         1024
+#define JOY_LEFT         2048
+#define JOY_MODE1        4096
+#define JOY_MODE2        16384
+
+// Field geometry:
+// set at build time ("make FIELDWIDTH=16"; see the Makefile), for the
+// game and the host tools alike.  Everything else - the row masks, the
+// save format, and the layout of the screen in blox.c - follows from
+// these.
+//
+#ifndef FIELDWIDTH
+#define FIELDWIDTH       10	// Field size - # tiles wide
+#endif
+#ifndef FIELDHEIGHT
+#define FIELDHEIGHT      20	// (# tiles high)
+#endif
+#ifndef FIELDHIDHT
+#define FIELDHIDHT       4	// height of 'hidden' portion at top
+#endif
+
+#if (FIELDWIDTH < 4) || (FIELDWIDTH > 32)
+#error "FIELDWIDTH has to be 4 to 32 (a row is one bit per column)"
+#endif
+#if (FIELDHIDHT < 4)
+#error "FIELDHIDHT has to be at least 4 (a new piece starts wholly in the hidden rows)"
+#endif
+#if ((FIELDHEIGHT+FIELDHIDHT) > 32)
+#error "the field can be at most 32 rows, hidden ones included (see dirtyrows)"
+#endif
+
+// one row's occupancy mask (see dispmask): no wider than it has to be
+//
+#if (FIELDWIDTH <= 16)
+typedef uint16_t fieldrow;
+#else
+typedef uint32_t fieldrow;
+#endif
+
+#define FIELDBIT(col)    ((fieldrow)1 << (col))	// column's bit in a row mask
+#define FIELDFULLMASK    ((fieldrow)(0xFFFFFFFFu >> (32 - FIELDWIDTH)))	// occupancy mask of a completed row
+#define FIELDFLOOR       4	// solid rows kept below the field (see chkmvok)
+
+#define ALLROWS          (0xFFFFFFFFu >> (32 - (FIELDHEIGHT+FIELDHIDHT)))
+
+#define SCOREMAX         99999
+
+#define NEXTPIECES       4	// # of upcoming pieces known (power of 2)
+
+#define JOYRPTMASK       (JOY_LEFT|JOY_RIGHT|JOY_DOWN|JOY_I|JOY_II)
+#define JOYONCEMASK      (JOY_UP)	// buttons which only give a move when pressed
+#define JOYRPTINIT       15
+#define JOYRPTSUBS       3
+#define JOYBUTTONS       12	// buttons which have repeat state (JOY_I to JOY_LEFT)
+
+// auto-repeat state of one button
+//
+#define JOYST_UP         0	// not held
+#define JOYST_HELD       1	// pressed, waiting for the first repeat
+#define JOYST_RPT        2	// repeating
+
+typedef struct joyrpts
+{
+   uint8_t state;
+   uint8_t count;       // frames until it next repeats
+} joyrpt;
+
+// Profiling (PROFILE builds): the platform supplies prof_mark(), which is
+// called as each phase of the frame finishes
+//
+#define PROF_INPUT       0	// sensejoy(), joypadmv()
+#define PROF_GRAVITY     1	// piece falling, locking, next piece
+#define PROF_LINES       2	// testlines()
+#define PROF_SPRITES     3	// (platform) setsprvars(), SATB
+#define PROF_SCORE       4	// (platform) display_score()
+#define PROF_FIELD       5	// (platform) disp_playfield()
+#define PROF_PHASES      6
+
+#ifdef PROFILE
+void prof_mark(int phase);
+#define PROF_MARK(phase) prof_mark(phase)
+#else
+#define PROF_MARK(phase)
+#endif
+
+// game_frame() result bits
+//
+#define GAME_LOCKED      0x01	// the piece came to rest (and a new one was set)
+#define GAME_LINES       0x02	// lines were removed (see clearedrow[])
+#define GAME_LEVELUP     0x04	// difficulty level increased
+#define GAME_OVER        0x08	// the piece came to rest in the hidden area
+				// (or was pushed up into it - see game_garbage())
+
+#define GARBAGECOLOUR    8	// displn value of a garbage square (versus)
+
+// rotation systems (see game_set_rotation())
+//
+#define ROT_CLASSIC      0	// only the new phase's own offset (rotx, roty)
+#define ROT_KICKS        1	// then the rest of the piece's kicks (rotkicktbl[])
+
+
+//  Difficulty-level data:
+//  For now, it's a list of speed and next-level-starts-at scores
+//  speed is "vsync-frames per move", and score is in "lines cleared"
+
+typedef struct chlng_levels
+{
+   int    vsyncs;
+   int    score;
+} chlng_level;
+
+extern const chlng_level diff_level[];
+extern const int diff_numlevels;        // (# of entries)
+
+// The state of one game
+//
+typedef struct gamestates
+{
+   const chlng_level *difftbl;  // table in use (see game_set_levels())
+   int      numlevels;
+   int      rotmode;            // ROT_xxx (see game_set_rotation())
+
+   int      levelval;
+   int      scoreval;
+
+   int      frampermov;
+   int      fpmcount;
+
+   // Playfield:
+   // dispmask holds one occupancy bit per square (bit 0 = leftmost
+   // column), and is what collision-detection and line-testing look at.
+   // It is followed by FIELDFLOOR rows which are always full, so that a
+   // piece's 4 row masks can be tested without checking against the
+   // bottom edge.  displn is the colour plane (piece # + 1), and is only
+   // used for display.
+   //
+   fieldrow dispmask[(FIELDHEIGHT+FIELDHIDHT+FIELDFLOOR)];
+   char     displn[(FIELDHEIGHT+FIELDHIDHT)][FIELDWIDTH];
+
+   // # of filled squares in each row (a row is complete at FIELDWIDTH)
+   //
+   uint8_t  rowfill[(FIELDHEIGHT+FIELDHIDHT)];
+
+   // the top of the stack in each column: the row of its highest square,
+   // or FIELDHEIGHT+FIELDHIDHT if it is empty (there is nothing above it,
+   // so a piece dropped over a column can go down to just above it)
+   //
+   uint8_t  coltop[FIELDWIDTH];
+
+   // rows removed by the last call to testlines(), from the bottom up
+   // (numbered as they were before removal), and how many
+   //
+   int      clearedrow[4];
+   int      linescleared;
+
+   // joypad repeat values
+   //
+   joyrpt   joyrptstate[JOYBUTTONS];
+   int      joyout;
+
+   // piece type, rotation, position
+   //
+   char     pieceposx;
+   char     pieceposy;
+   char     piecenum;
+   char     phasenum;
+
+   // where the piece would land if it were dropped now (kept up to date
+   // by game_frame(), for the platform to draw)
+   //
+   char     ghostposy;
+
+   // the lowest row the piece's bottom has come down to so far: a kick
+   // may only lift the piece above where classic rotation would put it
+   // if its bottom stays down there (see rotate_to())
+   //
+   char     piecelow;
+
+   // Rows of the playfield which have changed since they were last drawn
+   // (bit n = row n of displn); the platform clears this as it redraws
+   //
+   uint32_t dirtyrows;
+
+   // Piece selection:
+   // a xorshift32 generator, seeded at the start of each game, shuffles
+   // the 7 pieces into a "bag", which is dealt out in order before the
+   // next bag is shuffled; the next NEXTPIECES pieces are kept in a ring,
+   // so that they can be looked at ahead of time.
+   //
+   uint32_t rngstate;
+   uint8_t  bag[NUMPIECES];
+   int      bagleft;
+   uint8_t  nextq[NEXTPIECES];
+   int      nextpos;
+} gamestate;
+
+void game_start(gamestate *gs, uint32_t seed);
+void game_set_levels(gamestate *gs, const chlng_level *tbl, int count);
+void game_default_levels(gamestate *gs);
+void game_set_rotation(gamestate *gs, int mode);
+int  game_frame(gamestate *gs, uint32_t pad);
+
+void sensejoy(gamestate *gs, uint32_t pad);
+void joypadmv(gamestate *gs);
+void setpiece(gamestate *gs);
+void nxtpiece(gamestate *gs);
+void snapshot(gamestate *gs, int type, int phase, int xpos, int ypos);
+void init_score(gamestate *gs);
+void clear_display_field(gamestate *gs);
+int  chkmvok(const gamestate *gs, int type, int phase, int xpos, int ypos, int xdelta, int ydelta);
+int  landing_row(const gamestate *gs, int type, int phase, int xpos, int ypos);
+int  rotate_to(const gamestate *gs, int type, int phase, int dir, int *xpos, int *ypos);
+int  testlines(gamestate *gs);
+uint32_t game_checksum(const gamestate *gs);
+int  game_peek(const gamestate *gs, int n);
+int  game_garbage(gamestate *gs, int lines, int hole);
+
+void     rng_seed(gamestate *gs, uint32_t seed);
+uint32_t rng_next(gamestate *gs);
+int      rng_range(gamestate *gs, int range);
+
+#endif
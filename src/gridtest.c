@@ -0,0 +1,239 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// gridtest - check the bitmask field (dispmask[] in game.c) against the
+//            byte grid it replaced
+//
+// usage:
+//   blox-gridtest
+//
+// The original rules kept the field as one byte per square, and worked
+// on it square by square, from the pieces' square lists (piecedata.h).
+// Those routines are kept here as they were (old_chkmvok(), old_snapshot()
+// and old_testlines()), on a grid of their own, and run side by side with
+// the game's.  Checks that:
+//   - chkmvok() gives the same answer for every piece, phase and nearby
+//     move, at every position in and around the field, on random fields
+//   - dropping random pieces and clearing lines (many games' worth),
+//     landing_row() finds the row the old rules would have, and after
+//     snapshot() and testlines() the field, its colours, its masks and
+//     the # of lines cleared are all the same
+//
+// Each piece is dropped in the column where it lands lowest, and drops
+// are only made while the stack is below the hidden rows, as in a game
+// (the old testlines() never looked at the top row).
+//
+// Exits with 1 if any check fails.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "game.h"
+#include "hosttest.h"
+#include "piecedata.h"
+
+#define BOARDS           256
+#define GAMES            2000
+#define BOARDROWS        (FIELDHEIGHT+FIELDHIDHT)
+
+
+static gamestate game;
+static char      grid[BOARDROWS][FIELDWIDTH];    // the old field
+
+
+// The original routines, on grid[]
+//
+static int old_chkmvok(int type, int phase, int xpos, int ypos, int xdelta, int ydelta)
+{
+int i, xoffset, yoffset;
+
+   for (i = 0; i < 4; i++) {
+      xoffset = (piecetbl[type] + phase)->square[i].x;
+      yoffset = (piecetbl[type] + phase)->square[i].y;
+
+      if (((xpos + xdelta + xoffset) < 0) ||
+          ((xpos + xdelta + xoffset) >= FIELDWIDTH) ||
+          ((ypos + ydelta + yoffset) < 0) ||
+          ((ypos + ydelta + yoffset) >= (FIELDHEIGHT + FIELDHIDHT)))
+         return(1);
+
+      if (grid[ypos + ydelta + yoffset][xpos + xdelta + xoffset] != 0)
+         return(1);
+   }
+   return(0);
+}
+
+static void old_snapshot(int type, int phase, int xpos, int ypos)
+{
+int i, xdelta, ydelta;
+
+   for (i = 0; i < 4; i++) {
+      xdelta = (piecetbl[type] + phase)->square[i].x;
+      ydelta = (piecetbl[type] + phase)->square[i].y;
+      grid[ypos + ydelta][xpos + xdelta] = (type + 1);
+   }
+}
+
+static int old_testlines(void)
+{
+int i, j, k;
+int flg;
+int deletelines = 0;
+
+   for (i = (FIELDHEIGHT+FIELDHIDHT - 1); i > 0; i--) {
+      flg = 0;
+
+      for (j = 0; j < FIELDWIDTH; j++) {
+         if (grid[i][j] == 0)
+            flg = 1;
+      }
+
+      if (flg != 1) {
+         for (k = i; k > 0; k--) {
+            for (j = 0; j < FIELDWIDTH; j++) {
+               grid[k][j] = grid[k-1][j];
+            }
+         }
+         deletelines++;
+         i = i + 1;  // the last line will need to be rechecked
+      }
+   }
+   return(deletelines);
+}
+
+// Both fields empty
+//
+static void new_board(uint32_t seed)
+{
+   game_start(&game, seed);
+   memset(grid, 0, sizeof(grid));
+}
+
+static void fill(int row, int col, int colour)
+{
+   game.dispmask[row]   |= FIELDBIT(col);
+   game.displn[row][col] = colour;
+   game.rowfill[row]++;
+   grid[row][col]        = colour;
+}
+
+// Is the game's field the same as the old one (and are its masks and
+// counts in step with its colours) ?
+//
+static int same_field(void)
+{
+int i, j, n;
+
+   if (memcmp(game.displn, grid, sizeof(grid)) != 0)
+      return(0);
+
+   for (i = 0; i < BOARDROWS; i++) {
+      n = 0;
+      for (j = 0; j < FIELDWIDTH; j++) {
+         if (((game.dispmask[i] & FIELDBIT(j)) != 0) != (grid[i][j] != 0))
+            return(0);
+         n += (grid[i][j] != 0);
+      }
+      if ((game.rowfill[i] != n) || ((game.dispmask[i] & ~FIELDFULLMASK) != 0))
+         return(0);
+   }
+   return(1);
+}
+
+static const int movex[4] = { 0, -1, 1, 0 };
+static const int movey[4] = { 0, 0, 0, 1 };
+
+int main(int argc, char *argv[])
+{
+long tests = 0, drops = 0, lines = 0, clears = 0;
+int collideok = 1, landok = 1, fieldok = 1, linesok = 1;
+int b, g, i, j, m, density, type, phase, x, y, n;
+char msg[100];
+
+   // collision: random fields, anything from nearly empty to nearly full
+   // (full rows included - chkmvok() doesn't care)
+   //
+   for (b = 0; b < BOARDS; b++) {
+      new_board(b + 1);
+      density = lcg_next(11);
+      for (i = lcg_next(BOARDROWS); i < BOARDROWS; i++)
+         for (j = 0; j < FIELDWIDTH; j++)
+            if (lcg_next(10) < density)
+               fill(i, j, 1 + lcg_next(NUMPIECES));
+
+      for (type = 0; type < NUMPIECES; type++)
+         for (phase = 0; phase < NUMPHASES; phase++)
+            for (y = -1; y < BOARDROWS; y++)
+               for (x = -2; x <= (FIELDWIDTH + 1); x++)
+                  for (m = 0; m < 4; m++) {
+                     if ((chkmvok(&game, type, phase, x, y, movex[m], movey[m]) != 0) !=
+                         (old_chkmvok(type, phase, x, y, movex[m], movey[m]) != 0))
+                        collideok = 0;
+                     tests++;
+                  }
+   }
+
+   // play: drop random pieces, lock them in and clear lines, until the
+   // stack reaches the hidden rows
+   //
+   for (g = 0; g < GAMES; g++) {
+      new_board(g + 1);
+
+      while (1) {
+         type  = lcg_next(NUMPIECES);
+         phase = lcg_next(NUMPHASES);
+
+         // the column where it lands lowest (so that rows fill up, and
+         // lines are cleared), starting from a random one
+         //
+         n = FIELDWIDTH - (piecetbl[type] + phase)->width + 1;
+         j = lcg_next(n);
+         x = y = -1;
+         for (m = 0; m < n; m++, j = (j + 1) % n) {
+            if (old_chkmvok(type, phase, j, 0, 0, 0) != 0)
+               continue;
+            for (i = 0; old_chkmvok(type, phase, j, i, 0, 1) == 0; i++)
+               ;
+            if (i > y) {
+               x = j;
+               y = i;
+            }
+         }
+         if (y < FIELDHIDHT)
+            break;
+
+         if (landing_row(&game, type, phase, x, 0) != y)
+            landok = 0;
+
+         old_snapshot(type, phase, x, y);
+         snapshot(&game, type, phase, x, y);
+         if (!same_field())
+            fieldok = 0;
+
+         n = old_testlines();
+         if (testlines(&game) != n)
+            linesok = 0;
+         if (!same_field())
+            fieldok = 0;
+
+         drops++;
+         lines  += n;
+         clears += (n != 0);
+      }
+   }
+
+   sprintf(msg, "chkmvok() agrees (%ld tests)", tests);
+   check(collideok, msg);
+   sprintf(msg, "landing_row() agrees (%ld drops)", drops);
+   check(landok, msg);
+   sprintf(msg, "the same field after each lock and clear (%ld lines)", lines);
+   check(fieldok, msg);
+   sprintf(msg, "testlines() clears as many lines (%ld clears)", clears);
+   check(linesok, msg);
+
+   return(check_exit());
+}
@@ -0,0 +1,60 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Helpers shared by the host tools (blox-savetest, blox-kicktest, ...)
+//
+// Each tool is one file built with the modules it checks, so these are
+// static, in this header, rather than a module of their own:
+//   check(ok, what)   print what, with "ok" or "FAILED" (counted in
+//                     failures)
+//   check_exit()      the exit status once all checks are done: 1 (after
+//                     saying how many failed) if any did, otherwise 0
+//   lcg_next(range)   a number from 0 to range-1, from lcgstate (which a
+//                     tool may set, to start a sequence over)
+//   now_sec()         the monotonic clock, in seconds
+//
+
+#ifndef HOSTTEST_H
+#define HOSTTEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int      failures = 0;
+static uint32_t lcgstate = 1;
+
+static inline void check(int ok, const char *what)
+{
+   printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+   if (!ok)
+      failures++;
+}
+
+static inline int check_exit(void)
+{
+   if (failures != 0) {
+      printf("\n%d check(s) FAILED\n", failures);
+      return(1);
+   }
+   return(0);
+}
+
+static inline uint32_t lcg_next(uint32_t range)
+{
+   lcgstate = (lcgstate * 1103515245) + 12345;
+   return((uint32_t)(((uint64_t)(lcgstate >> 1) * range) >> 31));
+}
+
+static inline double now_sec(void)
+{
+struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return(ts.tv_sec + (ts.tv_nsec / 1e9));
+}
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// kicktest - check the rotation systems (rotate_to() in game.c, and the
+//            kicks which mkpiecetbl builds)
+//
+// usage:
+//   blox-kicktest
+//
+// Every piece, phase and direction is rotated from every position it
+// fits in, on an empty field (against each wall, the floor and the top
+// row), on fields with a single column stacked up (1 to 4 high, in each
+// column), and on random fields.  Checks that:
+//   - classic rotation is the old rule: the new phase's (rotx, roty), or
+//     nothing
+//   - with kicks, a rotation which fits classically goes the same way
+//   - with kicks, the piece always ends up somewhere it fits, and only
+//     ever moves to one of its own kicks
+//   - with kicks, every piece rotates everywhere on an empty field
+//   - no rotation takes more than KICKMAX mask tests
+//   - with kicks, rotating back and forth (as the game does it, with
+//     gravity held off) never lifts a piece above the lowest row it has
+//     reached, by more than classic rotation's own offsets move its bottom
+// and reports how many rotations only kicks let through, and the average
+// # of mask tests.
+//
+// Exits with 1 if any check fails.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "game.h"
+#include "hosttest.h"
+
+#define RANDOMBOARDS     64
+#define CLIMBWALKS       64	// rotation walks on each random field
+#define CLIMBSTEPS       40	// (rotations in each)
+#define BOARDROWS        (FIELDHEIGHT+FIELDHIDHT)
+
+typedef struct tallies
+{
+   long     cases;
+   long     classic;            // rotations classic rotation allowed
+   long     kicked;             // (and those only kicks allowed)
+   long     tests;              // mask tests, with kicks
+   int      oldrule;            // classic mode differs from the old rule
+   int      notclassic;         // kicks went elsewhere when classic fit
+   int      misfit;             // kicks left the piece where it doesn't fit
+   int      notkick;            // kicks moved it somewhere not in its table
+   int      stuck;              // kicks failed (counted on empty fields)
+   int      toomany;            // more than KICKMAX tests
+} tally;
+
+
+static gamestate classic, kicks;
+
+
+// (rotation only looks at the masks, so the colours are left out)
+//
+static void fill(int row, int col)
+{
+   classic.dispmask[row] |= FIELDBIT(col);
+   kicks.dispmask[row]   |= FIELDBIT(col);
+}
+
+// (each rotation is tried as if the piece had just come down to where it
+// is, so any kick which keeps its bottom there may lift it)
+//
+static void new_boards(void)
+{
+   game_start(&classic, 1);
+   game_start(&kicks, 1);
+   classic.piecelow = kicks.piecelow = 0;
+}
+
+// Rotate from every position the piece fits in, both ways, in both
+// rotation systems
+//
+static void try_board(tally *t)
+{
+const piecemask *pm, *to;
+const rotkick *rk;
+int type, phase, dir, newphase, oldphase, k;
+int x, y, cx, cy, kx, ky, oldx, oldy;
+
+   for (type = 0; type < NUMPIECES; type++) {
+      for (phase = 0; phase < NUMPHASES; phase++) {
+         pm = &piecemasktbl[PIECEIDX(type, phase)];
+
+         for (dir = ROT_NEXT; dir <= ROT_PREV; dir++) {
+            rk = &rotkicktbl[KICKIDX(type, phase, dir)];
+            newphase = (phase + ((dir == ROT_NEXT) ? 1 : 3)) & 3;
+            to = &piecemasktbl[PIECEIDX(type, newphase)];
+
+            for (y = 0; y < BOARDROWS; y++) {
+               for (x = 0; x <= (FIELDWIDTH - pm->width); x++) {
+                  if (chkmvok(&classic, type, phase, x, y, 0, 0) != 0)
+                     continue;
+
+                  t->cases++;
+
+                  // the old rule, as joypadmv() had it
+                  //
+                  oldphase = -1;
+                  oldx = x;
+                  oldy = y;
+                  if (chkmvok(&classic, type, newphase, x, y, to->rotx, to->roty) == 0) {
+                     oldphase = newphase;
+                     oldx    += to->rotx;
+                     oldy    += to->roty;
+                     t->classic++;
+                  }
+
+                  cx = x;
+                  cy = y;
+                  if ((rotate_to(&classic, type, phase, dir, &cx, &cy) != oldphase) ||
+                      (cx != oldx) || (cy != oldy))
+                     t->oldrule++;
+
+                  kx = x;
+                  ky = y;
+                  if (rotate_to(&kicks, type, phase, dir, &kx, &ky) < 0) {
+                     t->stuck++;
+                     t->tests += rk->count;
+                     continue;
+                  }
+
+                  if ((oldphase >= 0) && ((kx != oldx) || (ky != oldy)))
+                     t->notclassic++;
+                  if (chkmvok(&kicks, type, newphase, kx, ky, 0, 0) != 0)
+                     t->misfit++;
+
+                  for (k = 0; k < rk->count; k++)
+                     if ((kx == (x + rk->dx[k])) && (ky == (y + rk->dy[k])))
+                        break;
+                  if (k == rk->count)
+                     t->notkick++;
+                  if (k >= KICKMAX)
+                     t->toomany++;
+
+                  t->tests += k + 1;
+                  if (oldphase < 0)
+                     t->kicked++;
+               }
+            }
+         }
+      }
+   }
+}
+
+// The row of a piece's bottom, in phase, less what classic rotation has
+// moved it since phase 0 (which comes back to 0 after a full turn); so
+// classic rotation alone only moves this between its lowest and highest
+// over the 4 phases
+//
+static int bottom_offset(int type, int phase)
+{
+int p, offset = 0;
+
+   for (p = 1; p <= phase; p++)
+      offset += piecemasktbl[PIECEIDX(type, p)].roty;
+   return(offset + piecemasktbl[PIECEIDX(type, phase)].height - 1);
+}
+
+// Set pieces down where they rest on the kicks field, and rotate them at
+// random, through game_frame() (pressing I or II every other frame, with
+// gravity held off).  Returns the # of walks in which a piece's bottom
+// rose above the lowest row it had reached by more than classic
+// rotation's offsets allow; counts the walks, and the rotations which
+// lifted the piece above its classic spot
+//
+static int try_climb(long *walks, long *lifted)
+{
+const piecemask *pm;
+int w, s, type, phase, x, y, p, rose = 0;
+int lo, hi, spread, lowest, bottom;
+
+   for (w = 0; w < CLIMBWALKS; w++) {
+      type  = lcg_next(NUMPIECES);
+      phase = lcg_next(NUMPHASES);
+      pm    = &piecemasktbl[PIECEIDX(type, phase)];
+      x     = lcg_next(FIELDWIDTH - pm->width + 1);
+
+      if (chkmvok(&kicks, type, phase, x, 0, 0, 0) != 0)
+         continue;
+      for (y = 0; chkmvok(&kicks, type, phase, x, y, 0, 1) == 0; y++)
+         ;
+
+      lo = hi = bottom_offset(type, 0);
+      for (p = 1; p < NUMPHASES; p++) {
+         lo = MIN(lo, bottom_offset(type, p));
+         hi = MAX(hi, bottom_offset(type, p));
+      }
+      spread = hi - lo;
+
+      kicks.piecenum  = type;
+      kicks.phasenum  = phase;
+      kicks.pieceposx = x;
+      kicks.pieceposy = y;
+      kicks.piecelow  = y + pm->height - 1;
+      lowest = kicks.piecelow;
+      (*walks)++;
+
+      for (s = 0; s < CLIMBSTEPS; s++) {
+         phase = kicks.phasenum;
+         y     = kicks.pieceposy;
+
+         kicks.fpmcount = 2;
+         game_frame(&kicks, (lcg_next(2) == 0) ? JOY_I : JOY_II);
+         kicks.fpmcount = 2;
+         game_frame(&kicks, 0);
+
+         if (kicks.phasenum == phase)
+            continue;
+
+         pm = &piecemasktbl[PIECEIDX(type, kicks.phasenum)];
+         if (kicks.pieceposy < (y + pm->roty))
+            (*lifted)++;
+
+         bottom = kicks.pieceposy + pm->height - 1;
+         if (bottom < (lowest - spread)) {
+            rose++;
+            break;
+         }
+         lowest = MAX(lowest, bottom);
+      }
+   }
+   return(rose);
+}
+
+static void report(const char *name, const tally *t)
+{
+   printf("%-14s %8ld rotations, %5.1f%% classic, %5.1f%% kicked, %.2f tests each\n",
+          name, t->cases, (100.0 * t->classic) / t->cases, (100.0 * t->kicked) / t->cases,
+          (double)t->tests / t->cases);
+}
+
+int main(int argc, char *argv[])
+{
+tally empty, stacked, random, all;
+long walks = 0, lifted = 0;
+int b, i, j, col, height, top, rose = 0;
+
+   memset(&empty, 0, sizeof(empty));
+   memset(&stacked, 0, sizeof(stacked));
+   memset(&random, 0, sizeof(random));
+
+   game_set_rotation(&classic, ROT_CLASSIC);
+   game_set_rotation(&kicks, ROT_KICKS);
+
+   // an empty field: the walls, the floor and the top row
+   //
+   new_boards();
+   try_board(&empty);
+
+   // a single column stacked up from the floor
+   //
+   for (col = 0; col < FIELDWIDTH; col++) {
+      for (height = 1; height <= 4; height++) {
+         new_boards();
+         for (i = 0; i < height; i++)
+            fill(BOARDROWS - 1 - i, col);
+         try_board(&stacked);
+         rose += try_climb(&walks, &lifted);
+      }
+   }
+
+   // random fields, as fieldcost.c makes them (each square filled with a
+   // chance of 0.6, up to 3/4 of the way up)
+   //
+   for (b = 0; b < RANDOMBOARDS; b++) {
+      new_boards();
+      top = BOARDROWS - lcg_next(((FIELDHEIGHT * 3) / 4) + 1);
+      for (i = BOARDROWS - 1; i >= top; i--)
+         for (j = 0; j < FIELDWIDTH; j++)
+            if (lcg_next(10) < 6)
+               fill(i, j);
+      try_board(&random);
+      rose += try_climb(&walks, &lifted);
+   }
+
+   report("empty field", &empty);
+   report("stacked column", &stacked);
+   report("random fields", &random);
+   printf("rotation walks %8ld, %ld rotations lifted by a kick\n", walks, lifted);
+   printf("\n");
+
+   all = empty;
+   all.oldrule    += stacked.oldrule    + random.oldrule;
+   all.notclassic += stacked.notclassic + random.notclassic;
+   all.misfit     += stacked.misfit     + random.misfit;
+   all.notkick    += stacked.notkick    + random.notkick;
+   all.toomany    += stacked.toomany    + random.toomany;
+
+   check(all.oldrule == 0, "classic rotation is the old rule");
+   check(all.notclassic == 0, "kicks rotate classically whenever that fits");
+   check(all.misfit == 0, "kicks only leave the piece where it fits");
+   check(all.notkick == 0, "kicks only move the piece by one of its kicks");
+   check(empty.stuck == 0, "kicks rotate every piece everywhere on an empty field");
+   check(all.toomany == 0, "no rotation takes more than KICKMAX mask tests");
+   check(rose == 0, "rotating never lifts a piece above the lowest it has been");
+
+   return(check_exit());
+}
@@ -0,0 +1,214 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// latency - measure the time from a button press to the move showing up
+//           on screen, through the joypad pipeline in pad.c
+//
+// usage:
+//   blox-latency [-n trials] [-w workticks] [-t tapticks] [-s seed]
+//
+// This runs pad.c and game.c against a model of the PC-FX's timing: a
+// vblank every PAD_FRAMETICKS, lasting VBLANKTICKS; the timer sampling the
+// pad every PAD_PERIOD ticks, out of step with the vblank (a random phase
+// for each trial); and each frame's work taking from workticks/2 to
+// workticks after the latch (default a quarter of a frame).  The piece is
+// a sprite, so a move shows up when the SATB is transferred: at the first
+// vblank after the timer interrupt which writes it to VRAM.
+//
+// Each trial presses LEFT at a random time, and holds it for tapticks
+// (default: until the piece has moved).  The same presses are also put
+// through the old pipeline - the pad read once per frame at vblank, and
+// the SATB going through the VRAM queue (so transferred a vblank after
+// the BG changes) - for comparison.  Latency is reported in frames, from
+// the press to the start of the display which shows the move; presses
+// which never move the piece are counted as missed.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "hosttest.h"
+#include "pad.h"
+
+#define TRIALS           100000
+#define VBLANKTICKS      ((PAD_FRAMETICKS * 23) / 263)	// (as in blox.c)
+#define PRESSFRAME       10	// presses are in frames 10 to 29 of a game
+#define PRESSFRAMES      20
+#define WAITFRAMES       10	// frames after the press to wait for a move
+
+static uint32_t workticks = PAD_FRAMETICKS / 4;
+static uint32_t holdticks = 0xFFFFFFFF;
+static long     overruns;
+
+static gamestate game;
+
+static uint32_t pad_at(uint32_t time, uint32_t press)
+{
+   return(((time >= press) && ((time - press) < holdticks)) ? JOY_LEFT : 0);
+}
+
+// Timer-sampled pad, latched late in the frame; the SATB is written by
+// the timer interrupt once the frame's work is done
+//
+static int trial_timer(uint32_t seed, uint32_t press, uint32_t phase, double *frames)
+{
+uint32_t vblank, latch, work, done, sample, push, visible;
+int32_t latency;
+int f, x;
+
+   game_start(&game, seed);
+   pad_reset(0);
+   sample = phase;
+
+   for (f = 0; f < (PRESSFRAME + PRESSFRAMES + WAITFRAMES); f++) {
+      vblank = f * PAD_FRAMETICKS;
+      latch  = pad_deadline(vblank);
+      work   = (workticks / 2) + lcg_next((workticks / 2) + 1);
+
+      while (sample < latch) {
+         pad_sample(pad_at(sample, press), sample);
+         sample += PAD_PERIOD;
+      }
+
+      x = game.pieceposx;
+      game_frame(&game, pad_latch(latch, &latency));
+
+      done = latch + work;
+      pad_work(work);
+      if (done > (vblank + PAD_FRAMETICKS))
+         overruns++;
+
+      if (game.pieceposx != x) {
+         push = sample;
+         while ((push < done) || ((push % PAD_FRAMETICKS) < VBLANKTICKS))
+            push += PAD_PERIOD;
+
+         visible = (((push / PAD_FRAMETICKS) + 1) * PAD_FRAMETICKS) + VBLANKTICKS;
+         *frames = (double)(visible - press) / PAD_FRAMETICKS;
+         return(1);
+      }
+   }
+   return(0);
+}
+
+// Pad read at vblank; the SATB is queued, written during the next vblank,
+// and transferred at the one after that
+//
+static int trial_vblank(uint32_t seed, uint32_t press, double *frames)
+{
+uint32_t vblank, visible;
+int f, x;
+
+   game_start(&game, seed);
+
+   for (f = 0; f < (PRESSFRAME + PRESSFRAMES + WAITFRAMES); f++) {
+      vblank = f * PAD_FRAMETICKS;
+
+      x = game.pieceposx;
+      game_frame(&game, pad_at(vblank, press));
+
+      if (game.pieceposx != x) {
+         visible = ((f + 2) * PAD_FRAMETICKS) + VBLANKTICKS;
+         *frames = (double)(visible - press) / PAD_FRAMETICKS;
+         return(1);
+      }
+   }
+   return(0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+double x = *(const double *)a;
+double y = *(const double *)b;
+
+   return((x > y) - (x < y));
+}
+
+static void report(const char *name, double *vals, long count, long trials)
+{
+double sum = 0;
+long i;
+
+   if (count == 0) {
+      printf("  %-12s       -      -      -      -      -   %6.2f%%\n", name, 100.0);
+      return;
+   }
+
+   qsort(vals, count, sizeof(double), cmp_double);
+   for (i = 0; i < count; i++)
+      sum += vals[i];
+
+   printf("  %-12s  %6.2f %6.2f %6.2f %6.2f %6.2f   %6.2f%%\n", name,
+          sum / count, vals[0], vals[count / 2], vals[(count * 9) / 10], vals[count - 1],
+          ((trials - count) * 100.0) / trials);
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage:\n    blox-latency [-n trials] [-w workticks] [-t tapticks] [-s seed]\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+long trials = TRIALS;
+long i, ntimer = 0, nvblank = 0;
+uint32_t seed = 1;
+uint32_t press;
+double *timervals, *vblankvals;
+int n;
+
+   for (n = 1; n < argc; n++) {
+      if ((strcmp(argv[n], "-n") == 0) && (n + 1 < argc))
+         trials = atol(argv[++n]);
+      else if ((strcmp(argv[n], "-w") == 0) && (n + 1 < argc))
+         workticks = strtoul(argv[++n], NULL, 0);
+      else if ((strcmp(argv[n], "-t") == 0) && (n + 1 < argc))
+         holdticks = strtoul(argv[++n], NULL, 0);
+      else if ((strcmp(argv[n], "-s") == 0) && (n + 1 < argc))
+         seed = strtoul(argv[++n], NULL, 0);
+      else
+         usage();
+   }
+
+   if ((trials < 1) || (workticks >= PAD_FRAMETICKS) || (holdticks == 0))
+      usage();
+
+   timervals  = malloc(trials * sizeof(double));
+   vblankvals = malloc(trials * sizeof(double));
+   if ((timervals == NULL) || (vblankvals == NULL)) {
+      fprintf(stderr, "blox-latency: out of memory\n");
+      return(1);
+   }
+
+   lcgstate = seed;
+
+   for (i = 0; i < trials; i++) {
+      press = ((PRESSFRAME + lcg_next(PRESSFRAMES)) * PAD_FRAMETICKS) + lcg_next(PAD_FRAMETICKS);
+
+      if (trial_timer(seed + i, press, lcg_next(PAD_PERIOD), &timervals[ntimer]))
+         ntimer++;
+      if (trial_vblank(seed + i, press, &vblankvals[nvblank]))
+         nvblank++;
+   }
+
+   printf("press-to-visible latency, in frames (%ld trials, work %u ticks, ", trials, workticks);
+   if (holdticks == 0xFFFFFFFF)
+      printf("held)\n");
+   else
+      printf("tap %u ticks)\n", holdticks);
+
+   printf("                  mean    min    p50    p90    max    missed\n");
+   report("vblank pad", vblankvals, nvblank, trials);
+   report("timer pad", timervals, ntimer, trials);
+
+   if (overruns != 0)
+      printf("\n%ld frames ran past the next vblank\n", overruns);
+
+   return(0);
+}
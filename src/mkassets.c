@@ -0,0 +1,909 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// mkassets - build-time converter for all of the game's graphics
+//
+// usage:
+//   mkassets <manifest> <output.c> <output.h> <vram.h>
+//
+// Each line of the manifest describes one tile or sprite, with the same
+// arguments as cvtgfx.py:
+//   <tile|sprite> <name> <ASCII_art_file> <offset_x> <offset_y> <x_tiles> <y_tiles> <x_virtual_size> <xlate_file>
+// or a font, from 8x8 1bpp glyphs in an assembler file (.byte lines):
+//   font <name> <file.s> <first_char> "<characters used>"
+// or a region of VRAM which the game fills in itself:
+//   reserve <name> <words> <alignment> [<address>]
+// (blank lines and lines starting with '#' are skipped).
+//
+// Every ASCII art file is read once, however many entries use it.  The
+// data is converted as cvtgfx.py does it, into HuC6270 tile or sprite
+// format, then packed (see assetpack.h): identical cells are kept once,
+// and each cell is run-length coded.
+//
+// Everything is then given a place in VRAM: the reserved regions with an
+// address first, then the rest in manifest order, each at the lowest
+// address which is free and suitably aligned.  Tiles are aligned to 16
+// words; sprites to their size, rounded up to a power of 2 (the HuC6270
+// ignores the low bits of a 32-wide or -tall sprite's pattern #).  The
+// addresses go into vram.h, as VRAM_<name> (without any "_data").
+//
+// The tiles and sprites, in address order, make up a VRAM image: each
+// run of them with no gap in between is one range, unpacked by boot with
+// a single stream of writes.  That goes into one C file, to be compiled
+// on its own.  The headers are only rewritten if they change, so that
+// new pixels don't make the game code recompile.
+//
+// The image is unpacked again and compared with the original data before
+// anything is written.
+//
+// A font becomes tiles in colour 3, one per character from the lowest to
+// the highest of those used; the ones in between which aren't used are
+// left blank.  vram.h also gets VRAM_<name>_FIRSTCHAR, the character at
+// VRAM_<name>.
+//
+// HuC6270 formats, for each 8x8 tile / 16x16 sprite:
+//   tile:   16 words - rows 0-7 as (plane 1 << 8) | plane 0, then rows
+//           0-7 as (plane 3 << 8) | plane 2; the leftmost pixel is bit 7
+//   sprite: 64 words - rows 0-15 of plane 0, then of planes 1, 2 and 3;
+//           the leftmost pixel is bit 15
+//
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "assetpack.h"
+
+#define MAXASSETS        256
+#define MAXFILES         32
+#define MAXLINES         1024
+#define MAXLINELEN       512	// (as cvtgfx.py)
+#define MAXWORDS         8192
+#define MAXCELLS         256	// (cell #s are bytes)
+#define MAXPACKED        65536
+#define VRAMWORDS        0x10000
+
+typedef struct artfiles
+{
+   char     name[256];
+   char    *line[MAXLINES];
+   int      numlines;
+   int      linelen;           // the shortest line's length
+} artfile;
+
+typedef struct assets
+{
+   char     name[64];
+   int      sprite;
+   int      reserved;          // (no data)
+   int      firstchar;         // font: the character of the first glyph, or -1
+   int      words;
+   long     align;
+   long     fixed;             // address from the manifest, or -1
+   long     addr;              // (-1 until placed)
+   uint16_t *data;
+   int      numcells;
+   uint8_t  cells[MAXWORDS / ASSET_TILEWORDS];
+} asset;
+
+static artfile  files[MAXFILES];
+static int      numfiles;
+static asset    assets[MAXASSETS];
+static int      numassets;
+static int      errors = 0;
+
+static const uint16_t *cells[MAXCELLS];       // (the first asset data it was found in)
+static int      cellwords[MAXCELLS];
+static int      celloff[MAXCELLS];
+static int      numcells;
+static uint8_t  packed[MAXPACKED];
+static int      packedlen;
+
+static int      order[MAXASSETS];             // assets with data, by address
+static int      numordered;
+static int      rangestart[MAXASSETS];        // (index into order[])
+static int      numranges;
+
+static void fail(const char *manifest, int lineno, const char *msg, const char *arg)
+{
+   fprintf(stderr, "mkassets: %s line %d: %s%s\n", manifest, lineno, msg, arg);
+   errors++;
+}
+
+// Read an ASCII art (or xlate) file, or find it if it has been read
+// already
+//
+static const artfile *read_art(const char *filename)
+{
+FILE *infile;
+artfile *af;
+char buf[4096];
+int i, len;
+
+   for (i = 0; i < numfiles; i++)
+      if (strcmp(files[i].name, filename) == 0)
+         return(&files[i]);
+
+   if (numfiles == MAXFILES)
+      return(NULL);
+
+   infile = fopen(filename, "r");
+   if (infile == NULL)
+      return(NULL);
+
+   af = &files[numfiles++];
+   snprintf(af->name, sizeof(af->name), "%s", filename);
+   af->numlines = 0;
+   af->linelen  = MAXLINELEN;
+
+   while ((af->numlines < MAXLINES) && (fgets(buf, sizeof(buf), infile) != NULL)) {
+      len = strlen(buf);
+      if ((len > 0) && (buf[len - 1] == '\n'))
+         buf[--len] = '\0';
+
+      af->line[af->numlines++] = strdup(buf);
+      af->linelen = (len < af->linelen) ? len : af->linelen;
+   }
+
+   fclose(infile);
+   return(af);
+}
+
+// Gather every 4th bit of a 64-bit word (bits 0, 4, 8 ... 60) into the
+// low 16 bits
+//
+static uint16_t gather4(uint64_t x)
+{
+   x &= 0x1111111111111111ULL;
+   x = (x | (x >> 3))  & 0x0303030303030303ULL;
+   x = (x | (x >> 6))  & 0x000F000F000F000FULL;
+   x = (x | (x >> 12)) & 0x000000FF000000FFULL;
+   x = (x | (x >> 24)) & 0x000000000000FFFFULL;
+   return((uint16_t)x);
+}
+
+// One row of pixels as the 4 bitplanes; pixel 0 ends up in the top bit
+// of each (bit width-1)
+//
+static int pack_row(const char *src, int width, const char *xlate, uint16_t plane[4])
+{
+uint64_t nibbles = 0;
+const char *p;
+int i;
+
+   for (i = 0; i < width; i++) {
+      p = strchr(xlate, src[i]);
+      if ((p == NULL) || (src[i] == '\0'))
+         return(-1);
+      nibbles = (nibbles << 4) | (uint64_t)(p - xlate);
+   }
+
+   for (i = 0; i < 4; i++)
+      plane[i] = gather4(nibbles >> i);
+
+   return(0);
+}
+
+static int convert(asset *a, const artfile *art, const char *xlate,
+                   int xoff, int yoff, int xtiles, int ytiles, int virtwidth)
+{
+int size   = a->sprite ? 16 : 8;
+int words  = a->sprite ? 64 : 16;
+int i, j, k, y;
+uint16_t plane[4];
+uint16_t *out;
+
+   for (i = 0; i < ytiles; i++) {
+      for (j = 0; j < xtiles; j++) {
+         out = a->data + (((virtwidth * i) + j) * words);
+
+         if ((out + words) > (a->data + a->words))
+            return(-1);
+
+         for (k = 0; k < size; k++) {
+            y = yoff + (i * size) + k;
+
+            if (pack_row(art->line[y] + xoff + (j * size), size, xlate, plane) != 0)
+               return(-2);
+
+            if (a->sprite) {
+               out[k]      = plane[0];
+               out[k + 16] = plane[1];
+               out[k + 32] = plane[2];
+               out[k + 48] = plane[3];
+            }
+            else {
+               out[k]      = plane[0] | (plane[1] << 8);
+               out[k + 8]  = plane[2] | (plane[3] << 8);
+            }
+         }
+      }
+   }
+   return(0);
+}
+
+// Expand the glyphs of a font which are used into tiles; returns an error
+// message, or NULL
+//
+static const char *convert_font(asset *a, const artfile *src, int first, const char *used)
+{
+static uint8_t glyphs[256 * 8];
+int numbytes = 0;
+int lo = 255;
+int hi = 0;
+const char *p;
+char *end;
+long val;
+int i, c, k;
+
+   for (i = 0; i < src->numlines; i++) {
+      p = strstr(src->line[i], ".byte");
+      end = strchr(src->line[i], '#');
+      if ((p == NULL) || ((end != NULL) && (end < p)))
+         continue;
+
+      p += 5;
+      while ((*p != '\0') && (*p != '#')) {
+         val = strtol(p, &end, 0);
+         if ((end == p) || (numbytes == sizeof(glyphs)))
+            return("bad .byte line in the font");
+         glyphs[numbytes++] = val;
+         p = end + strspn(end, " \t,");
+      }
+   }
+
+   for (p = used; *p != '\0'; p++) {
+      c = (unsigned char)*p;
+      if ((c < first) || ((c - first) >= (numbytes / 8)))
+         return("character not in the font, in ");
+      lo = (c < lo) ? c : lo;
+      hi = (c > hi) ? c : hi;
+   }
+   if (lo > hi)
+      return("no characters used, in ");
+
+   a->firstchar = lo;
+   a->words = (hi - lo + 1) * ASSET_TILEWORDS;
+   a->data  = calloc(a->words, sizeof(uint16_t));
+
+   for (p = used; *p != '\0'; p++) {
+      c = (unsigned char)*p;
+      for (k = 0; k < 8; k++)
+         a->data[((c - lo) * ASSET_TILEWORDS) + k] = glyphs[((c - first) * 8) + k] * 0x0101;
+   }
+   return(NULL);
+}
+
+// Run-length code one cell; returns the # of bytes
+//
+static int pack_cell(const uint16_t *src, int words, uint8_t *out)
+{
+uint8_t *start = out;
+int i = 0;
+int j, n;
+
+   while (i < words) {
+      n = 1;
+
+      if (src[i] == 0) {
+         while (((i + n) < words) && (n < ASSET_MAXCOUNT) && (src[i + n] == 0))
+            n++;
+         *out++ = ASSET_ZERO | (n - 1);
+      }
+      else if (((i + 1) < words) && (src[i + 1] == src[i])) {
+         while (((i + n) < words) && (n < ASSET_MAXCOUNT) && (src[i + n] == src[i]))
+            n++;
+         *out++ = ASSET_RUN | (n - 1);
+         *out++ = src[i] & 0xFF;
+         *out++ = src[i] >> 8;
+      }
+      else {
+         // up to the next zero or run
+         //
+         while (((i + n) < words) && (n < ASSET_MAXCOUNT) && (src[i + n] != 0) &&
+                (((i + n + 1) >= words) || (src[i + n + 1] != src[i + n])))
+            n++;
+         *out++ = ASSET_WORDS | (n - 1);
+         for (j = 0; j < n; j++) {
+            *out++ = src[i + j] & 0xFF;
+            *out++ = src[i + j] >> 8;
+         }
+      }
+      i += n;
+   }
+   return(out - start);
+}
+
+// Unpack one cell (as load_asset() does, but into memory); returns the #
+// of words, or -1 if the codes run past the end of the cell
+//
+static int unpack_cell(const uint8_t *src, int words, uint16_t *out)
+{
+int i = 0;
+int n, code;
+uint16_t val;
+
+   while (i < words) {
+      code = *src++;
+      n = (code & ASSET_COUNTMASK) + 1;
+      if ((i + n) > words)
+         return(-1);
+
+      switch (code & ASSET_CODEMASK) {
+      case ASSET_ZERO:
+         while (n-- > 0)
+            out[i++] = 0;
+         break;
+
+      case ASSET_RUN:
+         val = src[0] | (src[1] << 8);
+         src += 2;
+         while (n-- > 0)
+            out[i++] = val;
+         break;
+
+      case ASSET_WORDS:
+         while (n-- > 0) {
+            out[i++] = src[0] | (src[1] << 8);
+            src += 2;
+         }
+         break;
+
+      default:
+         return(-1);
+      }
+   }
+   return(i);
+}
+
+// Split each asset into cells, keep each different cell once, and pack
+// those
+//
+static void pack_assets(void)
+{
+asset *a;
+const uint16_t *cell;
+int n, i, c, size;
+
+   for (n = 0; n < numassets; n++) {
+      a = &assets[n];
+      if (a->reserved)
+         continue;
+
+      size = a->sprite ? ASSET_SPRWORDS : ASSET_TILEWORDS;
+      a->numcells = a->words / size;
+
+      for (i = 0; i < a->numcells; i++) {
+         cell = a->data + (i * size);
+
+         for (c = 0; c < numcells; c++)
+            if ((cellwords[c] == size) && (memcmp(cells[c], cell, size * sizeof(uint16_t)) == 0))
+               break;
+
+         if (c == numcells) {
+            if ((numcells == MAXCELLS) || ((packedlen + (size * 3)) > MAXPACKED)) {
+               fprintf(stderr, "mkassets: too many different cells\n");
+               errors++;
+               return;
+            }
+            cells[c]     = cell;
+            cellwords[c] = size;
+            celloff[c]   = packedlen;
+            packedlen   += pack_cell(cell, size, packed + packedlen);
+            numcells++;
+         }
+         a->cells[i] = c;
+      }
+   }
+}
+
+// Is any of lo ... lo+words-1 already taken?  Returns the asset which
+// has it, or -1
+//
+static int vram_taken(long lo, long words)
+{
+const asset *a;
+int n;
+
+   for (n = 0; n < numassets; n++) {
+      a = &assets[n];
+      if ((a->addr >= 0) && (lo < (a->addr + a->words)) && (a->addr < (lo + words)))
+         return(n);
+   }
+   return(-1);
+}
+
+static int cmp_addr(const void *x, const void *y)
+{
+long a = assets[*(const int *)x].addr;
+long b = assets[*(const int *)y].addr;
+
+   return((a > b) - (a < b));
+}
+
+// Give everything a place in VRAM, then sort the tiles and sprites into
+// ranges
+//
+static void place_assets(void)
+{
+asset *a, *prev;
+long addr;
+int n, i;
+
+   // regions with a fixed address first
+   //
+   for (n = 0; n < numassets; n++) {
+      a = &assets[n];
+      if (a->fixed < 0)
+         continue;
+
+      i = vram_taken(a->fixed, a->words);
+      if (i >= 0)
+         fprintf(stderr, "mkassets: %s: overlaps %s\n", a->name, assets[i].name);
+      else if (((a->fixed % a->align) != 0) || ((a->fixed + a->words) > VRAMWORDS))
+         fprintf(stderr, "mkassets: %s: cannot go at 0x%04lX\n", a->name, a->fixed);
+      else {
+         a->addr = a->fixed;
+         continue;
+      }
+      errors++;
+   }
+
+   // then the rest, at the lowest free address
+   //
+   for (n = 0; n < numassets; n++) {
+      a = &assets[n];
+      if (a->addr >= 0)
+         continue;
+
+      addr = 0;
+      while ((addr + a->words) <= VRAMWORDS) {
+         i = vram_taken(addr, a->words);
+         if (i < 0)
+            break;
+         addr = assets[i].addr + assets[i].words;
+         addr = (addr + a->align - 1) & ~(a->align - 1);
+      }
+
+      if ((addr + a->words) > VRAMWORDS) {
+         fprintf(stderr, "mkassets: %s: no room in VRAM\n", a->name);
+         errors++;
+         continue;
+      }
+      a->addr = addr;
+   }
+
+   if (errors != 0)
+      return;
+
+   for (n = 0; n < numassets; n++)
+      if (!assets[n].reserved)
+         order[numordered++] = n;
+
+   qsort(order, numordered, sizeof(int), cmp_addr);
+
+   // a new range wherever there is a gap, or tiles meet sprites
+   //
+   for (n = 0; n < numordered; n++) {
+      a = &assets[order[n]];
+      prev = (n > 0) ? &assets[order[n - 1]] : NULL;
+
+      if ((prev == NULL) || ((prev->addr + prev->words) != a->addr) || (prev->sprite != a->sprite))
+         rangestart[numranges++] = n;
+   }
+   rangestart[numranges] = numordered;
+}
+
+// Unpack the whole image, as the game does at boot, and compare it with
+// the converted data
+//
+static void verify_image(void)
+{
+static uint16_t vram[VRAMWORDS];
+const asset *a;
+long addr;
+int r, n, i, size;
+
+   for (r = 0; r < numranges; r++) {
+      addr = assets[order[rangestart[r]]].addr;
+
+      for (n = rangestart[r]; n < rangestart[r + 1]; n++) {
+         a = &assets[order[n]];
+         size = a->sprite ? ASSET_SPRWORDS : ASSET_TILEWORDS;
+
+         for (i = 0; i < a->numcells; i++) {
+            if (unpack_cell(packed + celloff[a->cells[i]], size, vram + addr) != size) {
+               fprintf(stderr, "mkassets: %s: cell %d does not unpack\n", a->name, i);
+               errors++;
+            }
+            addr += size;
+         }
+      }
+   }
+
+   for (n = 0; n < numordered; n++) {
+      a = &assets[order[n]];
+      if (memcmp(vram + a->addr, a->data, a->words * sizeof(uint16_t)) != 0) {
+         fprintf(stderr, "mkassets: %s does not unpack to the same data\n", a->name);
+         errors++;
+      }
+   }
+}
+
+static void read_manifest(const char *manifest)
+{
+FILE *infile;
+char line[1024], type[16], name[64], artname[256], xlatename[256];
+char xlate[17];
+const artfile *art, *xl;
+int lineno = 0;
+int xoff, yoff, xtiles, ytiles, virtwidth, size, n;
+long words, align, addr;
+const char *err;
+asset *a;
+char *p, *q, *r;
+
+   infile = fopen(manifest, "r");
+   if (infile == NULL) {
+      fprintf(stderr, "mkassets: cannot open %s\n", manifest);
+      exit(1);
+   }
+
+   while (fgets(line, sizeof(line), infile) != NULL) {
+      lineno++;
+      p = line + strspn(line, " \t");
+      if ((*p == '#') || (*p == '\n') || (*p == '\0'))
+         continue;
+
+      if (numassets == MAXASSETS) {
+         fail(manifest, lineno, "too many entries", "");
+         break;
+      }
+
+      a = &assets[numassets];
+      a->firstchar = -1;
+      a->fixed     = -1;
+      a->addr      = -1;
+
+      addr = -1;
+      n = sscanf(p, "%15s %63s %li %li %li", type, name, &words, &align, &addr);
+      if (strcmp(type, "reserve") == 0) {
+         if (n < 4) {
+            fail(manifest, lineno, "expected 4 or 5 fields", "");
+            continue;
+         }
+         if ((words < 1) || (words > VRAMWORDS) || (align < 1) || ((align & (align - 1)) != 0)) {
+            fail(manifest, lineno, "bad size or alignment for ", name);
+            continue;
+         }
+         snprintf(a->name, sizeof(a->name), "%s", name);
+         a->reserved = 1;
+         a->words    = words;
+         a->align    = align;
+         a->fixed    = addr;
+         numassets++;
+         continue;
+      }
+
+      if (strcmp(type, "font") == 0) {
+         q = strchr(p, '"');
+         r = (q != NULL) ? strchr(q + 1, '"') : NULL;
+         if ((sscanf(p, "%15s %63s %255s %li", type, name, artname, &words) != 4) || (r == NULL)) {
+            fail(manifest, lineno, "expected 5 fields", "");
+            continue;
+         }
+         *r = '\0';
+
+         art = read_art(artname);
+         if (art == NULL) {
+            fail(manifest, lineno, "cannot read ", artname);
+            continue;
+         }
+
+         snprintf(a->name, sizeof(a->name), "%s", name);
+         err = convert_font(a, art, words, q + 1);
+         if (err != NULL) {
+            fail(manifest, lineno, err, name);
+            continue;
+         }
+         a->align = ASSET_TILEWORDS;
+         numassets++;
+         continue;
+      }
+
+      if (sscanf(p, "%15s %63s %255s %d %d %d %d %d %255s", type, name, artname,
+                 &xoff, &yoff, &xtiles, &ytiles, &virtwidth, xlatename) != 9) {
+         fail(manifest, lineno, "expected 9 fields", "");
+         continue;
+      }
+
+      snprintf(a->name, sizeof(a->name), "%s", name);
+
+      if (strcmp(type, "tile") == 0)
+         a->sprite = 0;
+      else if (strcmp(type, "sprite") == 0)
+         a->sprite = 1;
+      else {
+         fail(manifest, lineno, "must be 'tile' or 'sprite': ", type);
+         continue;
+      }
+      size = a->sprite ? 16 : 8;
+
+      if ((xtiles < 1) || (ytiles < 1) || (xtiles > virtwidth) || (xoff < 0) || (yoff < 0)) {
+         fail(manifest, lineno, "bad tile counts or offsets for ", name);
+         continue;
+      }
+
+      art = read_art(artname);
+      if (art == NULL) {
+         fail(manifest, lineno, "cannot read ", artname);
+         continue;
+      }
+
+      xl = read_art(xlatename);
+      if ((xl == NULL) || (xl->numlines == 0)) {
+         fail(manifest, lineno, "cannot read ", xlatename);
+         continue;
+      }
+      snprintf(xlate, sizeof(xlate), "%s", xl->line[0]);     // (first 16 characters)
+
+      if ((yoff + (ytiles * size)) > art->numlines) {
+         fail(manifest, lineno, "extends beyond the lower edge of ", artname);
+         continue;
+      }
+      if ((xoff + (xtiles * size)) > art->linelen) {
+         fail(manifest, lineno, "extends beyond the right edge of ", artname);
+         continue;
+      }
+
+      a->words = xtiles * ytiles * (a->sprite ? 64 : 16);
+      if (a->words > MAXWORDS) {
+         fail(manifest, lineno, "too big: ", name);
+         continue;
+      }
+      a->data = calloc(a->words, sizeof(uint16_t));
+
+      a->align = ASSET_TILEWORDS;
+      if (a->sprite)
+         while (a->align < a->words)
+            a->align <<= 1;
+
+      switch (convert(a, art, xlate, xoff, yoff, xtiles, ytiles, virtwidth)) {
+      case -1:
+         fail(manifest, lineno, "virtual width leaves tiles outside of ", name);
+         continue;
+      case -2:
+         fail(manifest, lineno, "character not in the translate file, in ", name);
+         continue;
+      }
+
+      numassets++;
+   }
+
+   fclose(infile);
+}
+
+static int write_source(const char *filename, const char *header)
+{
+FILE *outfile;
+const asset *a;
+int i, n, r, cellcount, words;
+
+   outfile = fopen(filename, "w");
+   if (outfile == NULL) {
+      fprintf(stderr, "mkassets: cannot create %s\n", filename);
+      return(-1);
+   }
+
+   fprintf(outfile, "// %s\n", filename);
+   fprintf(outfile, "// HuC6270 tile and sprite data, packed (see assetpack.h)\n");
+   fprintf(outfile, "//\n");
+   fprintf(outfile, "// Generated by mkassets - do not edit\n");
+   fprintf(outfile, "//\n\n");
+   fprintf(outfile, "#include <stdint.h>\n\n");
+   fprintf(outfile, "#include \"%s\"\n\n", header);
+
+   fprintf(outfile, "const uint8_t assetcells[%d] = {\n", packedlen);
+   for (i = 0; i < packedlen; i++) {
+      fprintf(outfile, "%s0x%02X%s", ((i % 16) == 0) ? "  " : "", packed[i],
+              (i == (packedlen - 1)) ? "\n" : (((i % 16) == 15) ? ",\n" : ","));
+   }
+   fprintf(outfile, "};\n\n");
+
+   fprintf(outfile, "const uint16_t assetcelloff[%d] = {\n", numcells);
+   for (i = 0; i < numcells; i++) {
+      fprintf(outfile, "%s%5d%s", ((i % 8) == 0) ? "  " : "", celloff[i],
+              (i == (numcells - 1)) ? "\n" : (((i % 8) == 7) ? ",\n" : ","));
+   }
+   fprintf(outfile, "};\n");
+
+   for (r = 0; r < numranges; r++) {
+      fprintf(outfile, "\n");
+      cellcount = 0;
+      for (n = rangestart[r]; n < rangestart[r + 1]; n++) {
+         a = &assets[order[n]];
+         fprintf(outfile, "// 0x%04lX: %s, %d words\n", a->addr, a->name, a->words);
+         cellcount += a->numcells;
+      }
+
+      fprintf(outfile, "static const uint8_t vramcells%d[%d] = {\n", r, cellcount);
+      for (n = rangestart[r]; n < rangestart[r + 1]; n++) {
+         a = &assets[order[n]];
+         fprintf(outfile, " ");
+         for (i = 0; i < a->numcells; i++)
+            fprintf(outfile, " %d%s", a->cells[i],
+                    ((n == (rangestart[r + 1] - 1)) && (i == (a->numcells - 1))) ? "" : ",");
+         fprintf(outfile, "\n");
+      }
+      fprintf(outfile, "};\n");
+   }
+
+   fprintf(outfile, "\nconst vramrange vramimage[VRAMIMAGE_RANGES] = {\n");
+   for (r = 0; r < numranges; r++) {
+      words = 0;
+      cellcount = 0;
+      for (n = rangestart[r]; n < rangestart[r + 1]; n++) {
+         words     += assets[order[n]].words;
+         cellcount += assets[order[n]].numcells;
+      }
+      a = &assets[order[rangestart[r]]];
+      fprintf(outfile, "  { 0x%04lX, { %d, %d, %d, vramcells%d } }%s\n", a->addr, words,
+              a->sprite ? ASSET_SPRWORDS : ASSET_TILEWORDS, cellcount, r,
+              (r == (numranges - 1)) ? "" : ",");
+   }
+   fprintf(outfile, "};\n");
+
+   fclose(outfile);
+   return(0);
+}
+
+// Headers are built in memory, and only written if they differ from
+// what is there already
+//
+static char text[65536];
+static int  textlen;
+
+static void add_text(const char *fmt, ...)
+{
+va_list args;
+
+   va_start(args, fmt);
+   textlen += vsnprintf(text + textlen, sizeof(text) - textlen, fmt, args);
+   va_end(args);
+}
+
+static int write_text(const char *filename)
+{
+static char old[65536];
+FILE *file;
+int oldlen = 0;
+
+   file = fopen(filename, "r");
+   if (file != NULL) {
+      oldlen = fread(old, 1, sizeof(old), file);
+      fclose(file);
+      if ((oldlen == textlen) && (memcmp(old, text, textlen) == 0))
+         return(0);
+   }
+
+   file = fopen(filename, "w");
+   if (file == NULL) {
+      fprintf(stderr, "mkassets: cannot create %s\n", filename);
+      return(-1);
+   }
+   fwrite(text, 1, textlen, file);
+   fclose(file);
+   return(0);
+}
+
+static int write_header(const char *filename)
+{
+   textlen = 0;
+   add_text("// %s\n", filename);
+   add_text("// HuC6270 tile and sprite data, packed (see assetpack.h)\n");
+   add_text("//\n");
+   add_text("// Generated by mkassets - do not edit\n");
+   add_text("//\n\n");
+   add_text("#ifndef ASSETS_H\n#define ASSETS_H\n\n");
+   add_text("#include \"assetpack.h\"\n\n");
+   add_text("#define VRAMIMAGE_RANGES %d\n\n", numranges);
+   add_text("extern const uint8_t  assetcells[];\n");
+   add_text("extern const uint16_t assetcelloff[];\n");
+   add_text("extern const vramrange vramimage[VRAMIMAGE_RANGES];\n");
+   add_text("\n#endif\n");
+
+   return(write_text(filename));
+}
+
+// VRAM_<name> for each asset, in address order
+//
+static int write_layout(const char *filename)
+{
+static int byaddr[MAXASSETS];
+const asset *a;
+char name[80];
+int n, i, len;
+
+   for (n = 0; n < numassets; n++)
+      byaddr[n] = n;
+   qsort(byaddr, numassets, sizeof(int), cmp_addr);
+
+   textlen = 0;
+   add_text("// %s\n", filename);
+   add_text("// VRAM layout (word addresses)\n");
+   add_text("//\n");
+   add_text("// Generated by mkassets - do not edit\n");
+   add_text("//\n\n");
+   add_text("#ifndef VRAM_H\n#define VRAM_H\n\n");
+
+   for (n = 0; n < numassets; n++) {
+      a = &assets[byaddr[n]];
+
+      len = strlen(a->name);
+      if ((len > 5) && (strcmp(a->name + len - 5, "_data") == 0))
+         len -= 5;
+      for (i = 0; i < len; i++)
+         name[i] = toupper((unsigned char)a->name[i]);
+      name[len] = '\0';
+
+      add_text("#define VRAM_%-16s 0x%04lX\t// %s, %d words\n", name, a->addr,
+               a->reserved ? "reserved" : (a->sprite ? "sprite" : ((a->firstchar >= 0) ? "font" : "tile")),
+               a->words);
+      if (a->firstchar >= 0) {
+         strcat(name, "_FIRSTCHAR");
+         add_text("#define VRAM_%-16s 0x%02X\n", name, a->firstchar);
+      }
+   }
+   add_text("\n#endif\n");
+
+   return(write_text(filename));
+}
+
+int main(int argc, char *argv[])
+{
+const char *header;
+int n, words = 0, used = 0, vramused = 0;
+
+   if (argc != 5) {
+      fprintf(stderr, "Usage:\n    mkassets <manifest> <output.c> <output.h> <vram.h>\n");
+      return(1);
+   }
+
+   read_manifest(argv[1]);
+
+   if (errors == 0)
+      pack_assets();
+   if (errors == 0)
+      place_assets();
+   if (errors == 0)
+      verify_image();
+   if (errors != 0)
+      return(1);
+
+   header = strrchr(argv[3], '/');
+   header = (header != NULL) ? (header + 1) : argv[3];
+
+   if ((write_source(argv[2], header) != 0) || (write_header(argv[3]) != 0) ||
+       (write_layout(argv[4]) != 0))
+      return(1);
+
+   for (n = 0; n < numassets; n++) {
+      if (!assets[n].reserved) {
+         words += assets[n].words;
+         used  += assets[n].numcells;
+      }
+      vramused += assets[n].words;
+   }
+   printf("mkassets: %d assets, %d bytes; %d cells, %d different; packed to %d bytes\n",
+          numordered, words * 2, used, numcells, packedlen);
+   printf("mkassets: VRAM %d of %d words used; image is %d words in %d ranges\n",
+          vramused, VRAMWORDS, words, numranges);
+
+   return(0);
+}
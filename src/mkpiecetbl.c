@@ -0,0 +1,318 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// mkpiecetbl - build-time generator for piecemasktbl[]
+//
+// usage:
+//   mkpiecetbl <output_file>
+//
+// Reads the piece definitions from piecedata.h (p0phstbl..p6phstbl), and
+// writes them out as a flat table indexed by PIECEIDX(piece, phase), with
+// the squares of each phase packed into per-row bitmasks, and the bottom
+// edge of each column (for finding where a dropped piece lands).
+//
+// It also works out the rotation kicks (rotkicktbl[]) from the phases: for
+// each rotation, the classic offset first, and then each offset within
+// KICKREACH squares of it (across plus up/down) at which the rotated piece
+// still shares a square with the piece before rotation, so that a kick
+// never jumps the piece past anything.  They are ordered nearest first;
+// at the same distance, moves across come before moves up, which come
+// before moves down, and then the one which keeps the piece's centre
+// nearest to where it was (and then left before right).  The first
+// KICKMAX are kept.
+//
+// The generated table is checked against the source tables before it is
+// written, so a bad definition (overlapping squares, wrong width/height,
+// etc.) fails the build instead of producing a subtly different game.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pieces.h"
+#include "piecedata.h"
+
+static int errors = 0;
+
+typedef struct kickcands
+{
+   int   dx;
+   int   dy;
+   int   key[4];        // (sort order, most significant first)
+} kickcand;
+
+static void fail(int type, int phase, const char *msg)
+{
+   fprintf(stderr, "mkpiecetbl: piece %d phase %d: %s\n", type, phase, msg);
+   errors++;
+}
+
+static void build_entry(int type, int phase, piecemask *pm)
+{
+const piecephasedata *src = piecetbl[type] + phase;
+int i, x, y;
+
+   pm->rowmask[0] = pm->rowmask[1] = pm->rowmask[2] = pm->rowmask[3] = 0;
+   pm->bottom[0]  = pm->bottom[1]  = pm->bottom[2]  = pm->bottom[3]  = 0;
+
+   for (i = 0; i < 4; i++) {
+      x = src->square[i].x;
+      y = src->square[i].y;
+
+      if ((x < 0) || (x >= 4) || (y < 0) || (y >= 4)) {
+         fail(type, phase, "square outside of 4x4 cell");
+         continue;
+      }
+      pm->rowmask[y] |= (1 << x);
+      if (pm->bottom[x] < (y + 1))
+         pm->bottom[x] = y + 1;
+   }
+
+   pm->width      = src->width;
+   pm->height     = src->height;
+   pm->rotx       = src->sprite_x_rotate_adjustment;
+   pm->roty       = src->sprite_y_rotate_adjustment;
+   pm->sprpattern = SPRITE_PATTERN(src->sprpattern_vram_addr);
+}
+
+// Re-derive everything from the packed entry, and compare with the source
+//
+static void verify_entry(int type, int phase, const piecemask *pm)
+{
+const piecephasedata *src = piecetbl[type] + phase;
+int i, x, y, count;
+int maxx, maxy;
+
+   count = 0;
+   maxx = maxy = -1;
+
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 16; x++) {
+         if (pm->rowmask[y] & (1 << x)) {
+            count++;
+            if (x > maxx) maxx = x;
+            if (y > maxy) maxy = y;
+         }
+      }
+   }
+
+   if (count != 4)
+      fail(type, phase, "squares overlap");
+
+   for (i = 0; i < 4; i++) {
+      x = src->square[i].x;
+      y = src->square[i].y;
+      if ((pm->rowmask[y] & (1 << x)) == 0)
+         fail(type, phase, "square missing from row mask");
+   }
+
+   if ((maxx + 1) != src->width)
+      fail(type, phase, "width does not match squares");
+
+   if ((maxy + 1) != src->height)
+      fail(type, phase, "height does not match squares");
+
+   // each column's lowest square is at bottom - 1, with nothing below it
+   //
+   for (x = 0; x < 4; x++) {
+      if ((x < src->width) != (pm->bottom[x] > 0))
+         fail(type, phase, "empty column, or bottom past the width");
+
+      for (y = pm->bottom[x]; y < 4; y++)
+         if (pm->rowmask[y] & (1 << x))
+            fail(type, phase, "square below the bottom profile");
+
+      if ((pm->bottom[x] > 0) && ((pm->rowmask[pm->bottom[x] - 1] & (1 << x)) == 0))
+         fail(type, phase, "bottom profile not on a square");
+   }
+
+   if ((pm->rotx != src->sprite_x_rotate_adjustment) ||
+       (pm->roty != src->sprite_y_rotate_adjustment))
+      fail(type, phase, "rotation adjustment out of range");
+
+   if ((pm->sprpattern << 5) != src->sprpattern_vram_addr)
+      fail(type, phase, "sprite pattern address not 32-word aligned");
+}
+
+// Does piece b, at (x,y) from piece a, share a square with it ?
+//
+static int overlaps(const piecemask *a, const piecemask *b, int x, int y)
+{
+int row, brow;
+
+   for (row = 0; row < 4; row++) {
+      if (((row - y) < 0) || ((row - y) >= 4))
+         continue;
+
+      brow = b->rowmask[row - y];
+      brow = (x >= 0) ? (brow << x) : (brow >> -x);
+      if (a->rowmask[row] & brow)
+         return(1);
+   }
+   return(0);
+}
+
+static int cmp_cand(const void *p, const void *q)
+{
+const kickcand *a = p;
+const kickcand *b = q;
+int i;
+
+   for (i = 0; i < 4; i++)
+      if (a->key[i] != b->key[i])
+         return(a->key[i] - b->key[i]);
+   return(0);
+}
+
+static void build_kicks(const piecemask *tbl, int type, int phase, int dir, rotkick *rk)
+{
+const piecemask *from = &tbl[PIECEIDX(type, phase)];
+const piecemask *to   = &tbl[PIECEIDX(type, (phase + ((dir == ROT_NEXT) ? 1 : 3)) & 3)];
+kickcand cand[(2 * KICKREACH + 1) * (2 * KICKREACH + 1)];
+int n = 0, i, dx, dy;
+
+   memset(rk, 0, sizeof(*rk));
+
+   rk->dx[0] = to->rotx;
+   rk->dy[0] = to->roty;
+   rk->count = 1;
+
+   for (dy = -KICKREACH; dy <= KICKREACH; dy++) {
+      for (dx = -KICKREACH; dx <= KICKREACH; dx++) {
+         if (((dx == 0) && (dy == 0)) || ((abs(dx) + abs(dy)) > KICKREACH))
+            continue;
+         if (!overlaps(from, to, to->rotx + dx, to->roty + dy))
+            continue;
+
+         cand[n].dx     = to->rotx + dx;
+         cand[n].dy     = to->roty + dy;
+         cand[n].key[0] = abs(dx) + abs(dy);
+         cand[n].key[1] = (dy == 0) ? 0 : ((dy < 0) ? 1 : 2);
+         cand[n].key[2] = abs(((2 * cand[n].dx) + to->width) - from->width);
+         cand[n].key[3] = dx;
+         n++;
+      }
+   }
+
+   qsort(cand, n, sizeof(kickcand), cmp_cand);
+
+   for (i = 0; (i < n) && (rk->count < KICKMAX); i++) {
+      rk->dx[rk->count] = cand[i].dx;
+      rk->dy[rk->count] = cand[i].dy;
+      rk->count++;
+   }
+}
+
+// Each kick must be a different place, within reach of the classic one,
+// and (but for the classic one) overlap the piece before rotation
+//
+static void verify_kicks(const piecemask *tbl, int type, int phase, int dir, const rotkick *rk)
+{
+const piecemask *from = &tbl[PIECEIDX(type, phase)];
+const piecemask *to   = &tbl[PIECEIDX(type, (phase + ((dir == ROT_NEXT) ? 1 : 3)) & 3)];
+int i, j;
+
+   if ((rk->count < 1) || (rk->count > KICKMAX) ||
+       (rk->dx[0] != to->rotx) || (rk->dy[0] != to->roty))
+      fail(type, phase, "first kick is not the classic rotation");
+
+   for (i = 1; i < rk->count; i++) {
+      if ((abs(rk->dx[i] - to->rotx) + abs(rk->dy[i] - to->roty)) > KICKREACH)
+         fail(type, phase, "kick out of reach");
+      if (!overlaps(from, to, rk->dx[i], rk->dy[i]))
+         fail(type, phase, "kick jumps clear of the piece");
+      for (j = 0; j < i; j++)
+         if ((rk->dx[i] == rk->dx[j]) && (rk->dy[i] == rk->dy[j]))
+            fail(type, phase, "kick repeated");
+   }
+}
+
+int main(int argc, char *argv[])
+{
+piecemask tbl[NUMPIECES * NUMPHASES];
+rotkick kicks[NUMPIECES * NUMPHASES * 2];
+FILE *outfile;
+const piecemask *pm;
+const rotkick *rk;
+int type, phase, dir, i;
+
+   if (argc != 2) {
+      fprintf(stderr, "Usage:\n    mkpiecetbl <output_file>\n");
+      return(1);
+   }
+
+   for (type = 0; type < NUMPIECES; type++) {
+      for (phase = 0; phase < NUMPHASES; phase++) {
+         build_entry(type, phase, &tbl[PIECEIDX(type, phase)]);
+         verify_entry(type, phase, &tbl[PIECEIDX(type, phase)]);
+      }
+   }
+
+   for (type = 0; type < NUMPIECES; type++) {
+      for (phase = 0; phase < NUMPHASES; phase++) {
+         for (dir = ROT_NEXT; dir <= ROT_PREV; dir++) {
+            build_kicks(tbl, type, phase, dir, &kicks[KICKIDX(type, phase, dir)]);
+            verify_kicks(tbl, type, phase, dir, &kicks[KICKIDX(type, phase, dir)]);
+         }
+      }
+   }
+
+   if (errors != 0)
+      return(1);
+
+   outfile = fopen(argv[1], "w");
+   if (outfile == NULL) {
+      fprintf(stderr, "mkpiecetbl: cannot create %s\n", argv[1]);
+      return(1);
+   }
+
+   fprintf(outfile, "// %s\n", argv[1]);
+   fprintf(outfile, "// Piece collision masks, indexed by PIECEIDX(piece, phase), and rotation kicks\n");
+   fprintf(outfile, "//\n");
+   fprintf(outfile, "// Generated by mkpiecetbl from piecedata.h - do not edit\n");
+   fprintf(outfile, "//\n\n");
+   fprintf(outfile, "const piecemask piecemasktbl[NUMPIECES * NUMPHASES] = {\n");
+
+   for (type = 0; type < NUMPIECES; type++) {
+      for (phase = 0; phase < NUMPHASES; phase++) {
+         pm = &tbl[PIECEIDX(type, phase)];
+         fprintf(outfile, "  { { 0x%X, 0x%X, 0x%X, 0x%X }, %d, %d, %2d, %2d, { %d, %d, %d, %d }, 0x%03X },  // piece %d, phase %d\n",
+                 pm->rowmask[0], pm->rowmask[1], pm->rowmask[2], pm->rowmask[3],
+                 pm->width, pm->height, pm->rotx, pm->roty,
+                 pm->bottom[0], pm->bottom[1], pm->bottom[2], pm->bottom[3], pm->sprpattern,
+                 type, phase);
+      }
+   }
+
+   fprintf(outfile, "};\n\n");
+
+   fprintf(outfile, "// Rotation kicks, indexed by KICKIDX(piece, phase, direction): count,\n");
+   fprintf(outfile, "// then the x and the y offsets\n");
+   fprintf(outfile, "//\n");
+   fprintf(outfile, "const rotkick rotkicktbl[NUMPIECES * NUMPHASES * 2] = {\n");
+
+   for (type = 0; type < NUMPIECES; type++) {
+      for (phase = 0; phase < NUMPHASES; phase++) {
+         for (dir = ROT_NEXT; dir <= ROT_PREV; dir++) {
+            rk = &kicks[KICKIDX(type, phase, dir)];
+            fprintf(outfile, "  { %d, {", rk->count);
+            for (i = 0; i < KICKMAX; i++)
+               fprintf(outfile, "%s%2d", (i == 0) ? " " : ", ", rk->dx[i]);
+            fprintf(outfile, " }, {");
+            for (i = 0; i < KICKMAX; i++)
+               fprintf(outfile, "%s%2d", (i == 0) ? " " : ", ", rk->dy[i]);
+            fprintf(outfile, " } },  // piece %d, phase %d -> %d\n",
+                    type, phase, (phase + ((dir == ROT_NEXT) ? 1 : 3)) & 3);
+         }
+      }
+   }
+
+   fprintf(outfile, "};\n");
+   fclose(outfile);
+
+   return(0);
+}
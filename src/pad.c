@@ -0,0 +1,104 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Joypad input pipeline (see pad.h)
+//
+
+#include "pad.h"
+
+volatile uint32_t padheld;
+volatile uint32_t padtrg;
+
+static padsample padring[PAD_RINGSIZE];
+static volatile uint32_t padhead;      // (free-running; written by the interrupt)
+static volatile uint32_t padtail;      // (free-running; written by the main loop)
+static uint32_t padstate;              // buttons held, as of the last latch
+
+// ticks from the latch to the end of the frame's work: the most it has
+// been recently (it goes up at once, and comes down slowly)
+//
+static uint32_t padwork = PAD_FRAMETICKS / 2;
+
+// Forget any samples; the pad is taken to be in the given state (call
+// this before the timer interrupt is started)
+//
+void pad_reset(uint32_t pad)
+{
+   padtail  = padhead;
+   padheld  = pad;
+   padtrg   = 0;
+   padstate = pad;
+}
+
+// Called from the timer interrupt; only changes go into the ring.  If the
+// ring is full, the change is left to be picked up by a later sample.
+//
+void pad_sample(uint32_t pad, uint32_t time)
+{
+padsample *ps;
+
+   if (pad == padheld)
+      return;
+
+   if ((padhead - padtail) >= PAD_RINGSIZE)
+      return;
+
+   ps = &padring[padhead & (PAD_RINGSIZE - 1)];
+   ps->time = time;
+   ps->pad  = pad;
+   padhead++;
+
+   padtrg |= (~padheld) & pad;
+   padheld = pad;
+}
+
+// The input for this frame, at the given time.  latency is set to the
+// ticks since the earliest press taken out of the ring, or -1 if there
+// wasn't one.
+//
+uint32_t pad_latch(uint32_t time, int32_t *latency)
+{
+const padsample *ps;
+uint32_t pressed = 0;
+uint32_t newpress;
+
+   *latency = -1;
+
+   while (padtail != padhead) {
+      ps = &padring[padtail & (PAD_RINGSIZE - 1)];
+
+      newpress = (~padstate) & ps->pad;
+      if ((newpress != 0) && (pressed == 0))
+         *latency = time - ps->time;
+
+      pressed |= newpress;
+      padstate = ps->pad;
+      padtail++;
+   }
+
+   return(padstate | pressed);
+}
+
+// The latest time in the frame which started at vblank at which the pad
+// can be latched, and the frame's work still be done before the next one
+//
+uint32_t pad_deadline(uint32_t vblank)
+{
+   if ((padwork + PAD_MARGIN) >= PAD_FRAMETICKS)
+      return(vblank);
+
+   return(vblank + (PAD_FRAMETICKS - padwork - PAD_MARGIN));
+}
+
+// The frame's work took this many ticks after the latch
+//
+void pad_work(uint32_t ticks)
+{
+   if (ticks >= padwork)
+      padwork = ticks;
+   else
+      padwork -= (padwork - ticks) >> 6;
+}
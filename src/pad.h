@@ -0,0 +1,56 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Joypad input pipeline
+//
+// The pad is sampled by the timer interrupt PAD_SAMPLES times per frame
+// (pad_sample()), and each change goes into a ring along with the time at
+// which it was seen.  Once per frame, the main loop latches the pad
+// (pad_latch()): the ring is emptied, and the buttons held at the latest
+// sample - plus any which were pressed since the last latch, even if
+// they have been let go again - are that frame's input.
+//
+// The latch is put off until as late in the frame as the frame's work
+// allows (pad_deadline()), so that the input is as recent as possible
+// when the frame's display changes are committed.
+//
+// Times are in timer ticks.  None of this touches the hardware (the
+// platform supplies timer_now() and calls pad_sample()), so the host
+// tools use it as well.
+//
+
+#ifndef PAD_H
+#define PAD_H
+
+#include <stdint.h>
+
+#define PAD_FRAMETICKS   23864	// timer ticks per 1/60 second (15 CPU clocks each)
+#define PAD_SAMPLES      4	// pad samples per frame
+#define PAD_PERIOD       (PAD_FRAMETICKS / PAD_SAMPLES)	// timer period
+#define PAD_RINGSIZE     16	// changes held between latches (a power of 2)
+#define PAD_MARGIN       PAD_PERIOD	// time left spare after the frame's work
+
+typedef struct padsamples
+{
+   uint32_t time;       // when the change was seen
+   uint32_t pad;        // buttons held from then on
+} padsample;
+
+// for the vblank interrupt (menus, pause): the buttons held at the latest
+// sample, and those pressed since padtrg was last cleared
+//
+extern volatile uint32_t padheld;
+extern volatile uint32_t padtrg;
+
+uint32_t timer_now(void);
+
+void     pad_reset(uint32_t pad);
+void     pad_sample(uint32_t pad, uint32_t time);
+uint32_t pad_latch(uint32_t time, int32_t *latency);
+uint32_t pad_deadline(uint32_t vblank);
+void     pad_work(uint32_t ticks);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// This is the master definition of the pieces; it is only included by
+// mkpiecetbl.c, which derives piecemasktbl[] (piecetbl.gen_data) from it,
+// and by gridtest.c, which checks the game against the old square-by-
+// square rules.
+//
+
+#ifndef PIECEDATA_H
+#define PIECEDATA_H
+
+#include "pieces.h"
+#include "vram.h"
+
+// Piece orientation information:
+// the square data is used for detecting existing filled-blocks
+// (for collision-detection), and for sprite-to-block transfer
+// when the piece comes to rest
+//
+// sprite_x_rotate_adjustment (and y) is only used for piece #2, to
+// compensate for its special rotation (around its second square)
+//
+//
+// game pieces' data
+// -----------------
+//
+// piece #:         0     1     2     3     4     5     6
+//
+// appearance:      XX    XX    X     X      X    X     XX
+//                  X      X    XX    X     XX    XX    XX
+//                  X      X    X     X     X      X
+//                                    X
+// # rotation
+//   phases:        4     4     4     2     2     2     1
+//
+
+struct sqrpos {
+   int x;
+   int y;
+};
+
+typedef struct piecephasedatas {
+   int           width;
+   int           height;
+   struct sqrpos square[4];
+   uint16_t      sprpattern_vram_addr;
+   int           sprite_x_rotate_adjustment;
+   int           sprite_y_rotate_adjustment;
+} piecephasedata;
+
+
+static const piecephasedata p0phstbl[4] = {
+	{ 2, 3, {{0, 0}, {1, 0}, {0, 1}, {0, 2}}, VRAM_P0PH0, 0, 0 },
+	{ 3, 2, {{0, 0}, {0, 1}, {1, 1}, {2, 1}}, VRAM_P0PH1, 0, 0 },
+	{ 2, 3, {{1, 0}, {1, 1}, {1, 2}, {0, 2}}, VRAM_P0PH2, 0, 0 },
+	{ 3, 2, {{0, 0}, {1, 0}, {2, 0}, {2, 1}}, VRAM_P0PH3, 0, 0 }
+};
+
+static const piecephasedata p1phstbl[4] = {
+	{ 2, 3, {{0, 0}, {1, 0}, {1, 1}, {1, 2}}, VRAM_P1PH0, 0, 0 },
+	{ 3, 2, {{0, 0}, {0, 1}, {1, 0}, {2, 0}}, VRAM_P1PH1, 0, 0 },
+	{ 2, 3, {{0, 0}, {0, 1}, {0, 2}, {1, 2}}, VRAM_P1PH2, 0, 0 },
+	{ 3, 2, {{0, 1}, {1, 1}, {2, 1}, {2, 0}}, VRAM_P1PH3, 0, 0 }
+};
+
+static const piecephasedata p2phstbl[4] = {
+	{ 2, 3, {{0, 0}, {0, 1}, {1, 1}, {0, 2}}, VRAM_P2PH0, 0, 0 },
+	{ 3, 2, {{0, 1}, {1, 0}, {1, 1}, {2, 1}}, VRAM_P2PH1, 0, 0 },
+	{ 2, 3, {{0, 1}, {1, 0}, {1, 1}, {1, 2}}, VRAM_P2PH2, 0, 0 },
+	{ 3, 2, {{0, 0}, {1, 0}, {2, 0}, {1, 1}}, VRAM_P2PH3, 0, 0 }
+};
+
+static const piecephasedata p3phstbl[4] = {
+	{ 1, 4, {{0, 0}, {0, 1}, {0, 2}, {0, 3}}, VRAM_P3PH0,  1, -1 },
+	{ 4, 1, {{0, 0}, {1, 0}, {2, 0}, {3, 0}}, VRAM_P3PH1, -1,  1 },
+	{ 1, 4, {{0, 0}, {0, 1}, {0, 2}, {0, 3}}, VRAM_P3PH0,  1, -1 },  // Last two are same as first two
+	{ 4, 1, {{0, 0}, {1, 0}, {2, 0}, {3, 0}}, VRAM_P3PH1, -1,  1 }
+};
+
+static const piecephasedata p4phstbl[4] = {
+	{ 2, 3, {{1, 0}, {1, 1}, {0, 1}, {0, 2}}, VRAM_P4PH0, 0, 0 },
+	{ 3, 2, {{0, 0}, {1, 0}, {1, 1}, {2, 1}}, VRAM_P4PH1, 0, 0 },
+	{ 2, 3, {{1, 0}, {1, 1}, {0, 1}, {0, 2}}, VRAM_P4PH0, 0, 0 },  // Last two are same as first two
+	{ 3, 2, {{0, 0}, {1, 0}, {1, 1}, {2, 1}}, VRAM_P4PH1, 0, 0 }
+};
+
+static const piecephasedata p5phstbl[4] = {
+	{ 2, 3, {{0, 0}, {0, 1}, {1, 1}, {1, 2}}, VRAM_P5PH0, 0, 0 },
+	{ 3, 2, {{0, 1}, {1, 1}, {1, 0}, {2, 0}}, VRAM_P5PH1, 0, 0 },
+	{ 2, 3, {{0, 0}, {0, 1}, {1, 1}, {1, 2}}, VRAM_P5PH0, 0, 0 },  // Last two are same as first two
+	{ 3, 2, {{0, 1}, {1, 1}, {1, 0}, {2, 0}}, VRAM_P5PH1, 0, 0 }
+};
+
+static const piecephasedata p6phstbl[4] = {
+	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, VRAM_P6PH0, 0, 0 },
+	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, VRAM_P6PH0, 0, 0 },  // Last three are same as first one
+	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, VRAM_P6PH0, 0, 0 },
+	{ 2, 2, {{0, 0}, {0, 1}, {1, 0}, {1, 1}}, VRAM_P6PH0, 0, 0 }
+};
+
+// Note: It should not be odd to reference individual square positions as:
+// (piecetbl[piecenum] + phasenum)->square[squarenum].x
+static const piecephasedata * piecetbl[NUMPIECES] = {
+   p0phstbl, p1phstbl, p2phstbl, p3phstbl, p4phstbl, p5phstbl, p6phstbl
+};
+
+#endif
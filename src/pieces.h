@@ -0,0 +1,67 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Definitions shared between the game and the build-time piece table
+// generator (mkpiecetbl.c)
+//
+
+#ifndef PIECES_H
+#define PIECES_H
+
+#include <stdint.h>
+
+#define SPRITE_PATTERN(vramaddr)	(vramaddr >> 5)
+
+#define NUMPIECES	7
+#define NUMPHASES	4
+
+// Index into piecemasktbl[] for a given piece type and rotation phase
+//
+#define PIECEIDX(type, phase)	(((type) << 2) | (phase))
+
+// Flattened, precomputed piece/phase information:
+//
+// rowmask[] holds the occupied squares of each row of the piece, with
+// bit 0 being the leftmost column of the piece; rows below the piece's
+// height are zero, so a collision test can always look at all 4 rows.
+//
+typedef struct piecemasks {
+   uint16_t rowmask[4];
+   int8_t   width;
+   int8_t   height;
+   int8_t   rotx;         // sprite_x_rotate_adjustment
+   int8_t   roty;         // sprite_y_rotate_adjustment
+   int8_t   bottom[4];    // rows from the piece's top to below its lowest
+                          // square, in each column (0 past its width)
+   uint16_t sprpattern;   // SPRITE_PATTERN() code for the phase's sprite
+} piecemask;
+
+extern const piecemask piecemasktbl[NUMPIECES * NUMPHASES];
+
+// Rotation kicks (built by mkpiecetbl from the phases above):
+// the offsets to try, in order, when a piece in a given phase is rotated
+// to the next (ROT_NEXT) or previous (ROT_PREV) phase.  The first is the
+// classic rotation, the new phase's (rotx, roty); the rest are that moved
+// by up to KICKREACH squares, nearest first, to get off a wall or the
+// stack.
+//
+#define ROT_NEXT	0	// to phase + 1 (button I)
+#define ROT_PREV	1	// to phase - 1 (button II)
+
+#define KICKMAX		8	// most offsets tried for one rotation
+#define KICKREACH	2	// (furthest a kick moves the piece from classic)
+
+#define KICKIDX(type, phase, dir)	((PIECEIDX(type, phase) << 1) | (dir))
+
+typedef struct rotkicks {
+   int8_t   count;
+   int8_t   dx[KICKMAX];
+   int8_t   dy[KICKMAX];
+} rotkick;
+
+extern const rotkick rotkicktbl[NUMPIECES * NUMPHASES * 2];
+
+#endif
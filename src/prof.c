@@ -0,0 +1,217 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Frame-time profiler (see prof.h)
+//
+
+#include <string.h>
+
+#include <eris/types.h>
+#include <eris/tetsu.h>
+
+#include "prof.h"
+
+#define PROF_TOTAL       PROF_PHASES
+
+profstat profstats[PROF_PHASES + 1];
+profstat proflatency;
+profstat profvblank;
+uint32_t profoverruns;
+int      profrastermax;
+uint32_t profboot;                           // ticks from boot to the first frame
+int      profvqdepth;                        // (see prof_vramq())
+uint32_t profvqdeferred;
+int      profvramwords;
+
+static uint32_t proflast;                    // timer_now() at the last mark
+static uint32_t profstart;                   // (at the start of the frame)
+static uint32_t profframe[PROF_PHASES];      // ticks in each phase, this frame
+static uint8_t  profran[PROF_PHASES];        // did the phase run this frame ?
+
+static const char *profnames[PROF_PHASES + 1] = {
+   "INP", "GRV", "LIN", "SPR", "SCO", "FLD", "TOT"
+};
+
+static void prof_add(profstat *ps, uint32_t ticks)
+{
+int bucket = 0;
+int i;
+
+   if (ticks > 0xFFFF)
+      ticks = 0xFFFF;
+
+   if ((ps->frames == 0) || (ticks < ps->min))
+      ps->min = ticks;
+   if (ticks > ps->max)
+      ps->max = ticks;
+
+   // halve the running totals every so often, so that the average
+   // follows recent frames and the total can't overflow
+   //
+   if (ps->frames == 0x10000) {
+      ps->frames >>= 1;
+      ps->total  >>= 1;
+      for (i = 0; i < PROF_BUCKETS; i++)
+         ps->hist[i] >>= 1;
+   }
+   ps->frames++;
+   ps->total += ticks;
+
+   while (ticks && (bucket < (PROF_BUCKETS - 1))) {
+      bucket++;
+      ticks >>= 1;
+   }
+   ps->hist[bucket]++;
+}
+
+void prof_init(void)
+{
+   memset(profstats, 0, sizeof(profstats));
+   memset(&proflatency, 0, sizeof(proflatency));
+   memset(&profvblank, 0, sizeof(profvblank));
+   profoverruns  = 0;
+   profrastermax = 0;
+}
+
+void prof_frame_start(void)
+{
+   memset(profframe, 0, sizeof(profframe));
+   memset(profran, 0, sizeof(profran));
+
+   proflast  = timer_now();
+   profstart = proflast;
+
+   if (profboot == 0)
+      profboot = profstart;
+}
+
+// The phase which just finished (time since the last mark goes to it)
+//
+void prof_mark(int phase)
+{
+uint32_t now = timer_now();
+
+   profframe[phase] += now - proflast;
+   profran[phase]    = 1;
+   proflast = now;
+}
+
+// The frame's work is done; overrun says whether it ran past the vblank
+// it was meant to be ready for
+//
+void prof_frame_end(int overrun)
+{
+int i;
+int raster = eris_tetsu_get_raster();
+
+   prof_add(&profstats[PROF_TOTAL], timer_now() - profstart);
+
+   for (i = 0; i < PROF_PHASES; i++)
+      if (profran[i])
+         prof_add(&profstats[i], profframe[i]);
+
+   if (overrun)
+      profoverruns++;
+
+   if (raster > profrastermax)
+      profrastermax = raster;
+}
+
+// A button press was latched, this many ticks after it was sampled
+//
+void prof_latency(int ticks)
+{
+   prof_add(&proflatency, ticks);
+}
+
+// The vblank interrupt took this many ticks to write out the VRAM queue
+// (called from the interrupt)
+//
+void prof_vblank(int ticks)
+{
+   prof_add(&profvblank, ticks);
+}
+
+// The VRAM queue's statistics: the most commands ever waiting in it, the
+// # of vblanks which ran out of budget, and the VRAM words written in the
+// last complete frame
+//
+void prof_vramq(int maxdepth, uint32_t deferred, int words)
+{
+   profvqdepth    = maxdepth;
+   profvqdeferred = deferred;
+   profvramwords  = words;
+}
+
+static void prof_number(char *buf, uint32_t val, int width)
+{
+int i;
+
+   for (i = width - 1; i >= 0; i--) {
+      buf[i] = (val || (i == (width - 1))) ? ('0' + (val % 10)) : ' ';
+      val = val / 10;
+   }
+}
+
+// Text for one line of the on-screen readout (PROF_LINELEN characters):
+//   lines 0 to PROF_PHASES  - phase name, average and maximum ticks
+//   next line               - the same, for press-to-latch latency
+//   next line               - the same, for the vblank's VRAM writes
+//   next line               - histogram of the whole frame's time, with
+//                             each bucket as a digit (tenths of the frames)
+//   next line               - overruns, and the lowest headroom in %
+//   next line               - latest raster line at which a frame's work
+//                             ended
+//   last line               - ticks from boot to the first frame
+//
+void prof_readout(int line, char *buf)
+{
+const profstat *ps;
+int i, max, headroom;
+
+   memset(buf, ' ', PROF_LINELEN);
+
+   if (line <= (PROF_PHASES + 2)) {
+      if (line <= PROF_PHASES)
+         ps = &profstats[line];
+      else
+         ps = (line == (PROF_PHASES + 1)) ? &proflatency : &profvblank;
+      memcpy(buf, (line <= PROF_PHASES) ? profnames[line] : ((line == (PROF_PHASES + 1)) ? "LAT" : "VBL"), 3);
+      prof_number(buf + 4, (ps->frames != 0) ? (ps->total / ps->frames) : 0, 5);
+      prof_number(buf + 10, ps->max, 5);
+   }
+   else if (line == (PROF_PHASES + 3)) {
+      ps = &profstats[PROF_TOTAL];
+      buf[0] = 'H';
+      for (i = 0; i < PROF_BUCKETS; i++)
+         buf[i + 1] = (ps->frames != 0) ? ('0' + MIN(9, (ps->hist[i] * 10) / ps->frames)) : '0';
+   }
+   else if (line == (PROF_PHASES + 4)) {
+      max = profstats[PROF_TOTAL].max;
+      headroom = (max < PROF_FRAMETICKS) ? (((PROF_FRAMETICKS - max) * 100) / PROF_FRAMETICKS) : 0;
+      memcpy(buf, "OVR", 3);
+      prof_number(buf + 3, profoverruns, 5);
+      memcpy(buf + 9, "FREE", 4);
+      prof_number(buf + 13, headroom, 3);
+      buf[16] = '%';
+   }
+   else if (line == (PROF_PHASES + 5)) {
+      memcpy(buf, "RAS", 3);
+      prof_number(buf + 4, profrastermax, 5);
+      memcpy(buf + 10, "WR", 2);
+      prof_number(buf + 12, profvramwords, 5);
+   }
+   else if (line == (PROF_PHASES + 6)) {
+      memcpy(buf, "VQ", 2);
+      prof_number(buf + 3, profvqdepth, 3);
+      memcpy(buf + 7, "DEF", 3);
+      prof_number(buf + 11, profvqdeferred, 6);
+   }
+   else {
+      memcpy(buf, "BOOT", 4);
+      prof_number(buf + 5, profboot, 10);
+   }
+}
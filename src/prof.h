@@ -0,0 +1,66 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Frame-time profiler (PROFILE builds only - "make PROFILE=1")
+//
+// The main loop is split into phases (see PROF_xxx in game.h); the time
+// each one takes is measured with timer_now() (see pad.h).
+//
+// For each phase, the profiler keeps min/avg/max and a histogram over the
+// frames in which the phase ran (bucket n counts frames which took 2^(n-1)
+// to 2^n - 1 ticks, and the last bucket everything longer).  It also counts
+// the frames whose work ran past the next vblank, and the latest raster
+// line at which a frame's work ended, the time from a button press
+// being sampled to the pad being latched, how long the vblank interrupt
+// takes to write out the frame's VRAM updates (this has to stay inside
+// the vblank - VBLANKTICKS in blox.c - for the display to keep up), and
+// how long boot took (from the timer being started at the top of init()
+// to the first frame).  blox.c also hands it the VRAM queue's statistics
+// (the most commands ever waiting, the vblanks which ran out of budget,
+// and the words written in the last frame), to show along with the rest.
+//
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+
+#include "game.h"
+#include "pad.h"
+
+#define PROF_FRAMETICKS  PAD_FRAMETICKS
+#define PROF_BUCKETS     16
+#define PROF_TEXTLINES   (PROF_PHASES + 8)	// # of lines in the readout
+#define PROF_LINELEN     17
+
+typedef struct profstats
+{
+   uint32_t frames;     // frames in which the phase ran
+   uint32_t total;      // ticks, over those frames
+   uint16_t min;
+   uint16_t max;
+   uint32_t hist[PROF_BUCKETS];
+} profstat;
+
+extern profstat profstats[PROF_PHASES + 1];	// (the last one is the whole frame)
+extern profstat proflatency;
+extern profstat profvblank;
+extern uint32_t profoverruns;
+extern int      profrastermax;
+extern uint32_t profboot;
+extern int      profvqdepth;
+extern uint32_t profvqdeferred;
+extern int      profvramwords;
+
+void prof_init(void);
+void prof_frame_start(void);
+void prof_frame_end(int overrun);
+void prof_latency(int ticks);
+void prof_vblank(int ticks);
+void prof_vramq(int maxdepth, uint32_t deferred, int words);
+void prof_readout(int line, char *buf);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Input recording and replay (see replay.h)
+//
+
+#include "game.h"
+#include "replay.h"
+
+// write out the run in progress
+//
+static int rec_flush(inputrec *rec)
+{
+uint8_t *out;
+
+   if (rec->run == 0)
+      return(1);
+
+   if ((rec->len + REC_RUNBYTES) > rec->size)
+      return(0);
+
+   out = rec->buf + rec->len;
+   out[0] = rec->pad & 0xFF;
+   out[1] = rec->pad >> 8;
+   out[2] = rec->run;
+
+   rec->len += REC_RUNBYTES;
+   rec->run  = 0;
+   return(1);
+}
+
+void rec_start(inputrec *rec, uint8_t *buf, int size, uint32_t seed)
+{
+   rec->buf    = buf;
+   rec->size   = size;
+   rec->len    = 0;
+   rec->pad    = 0;
+   rec->run    = 0;
+   rec->frames = 0;
+   rec->seed   = seed;
+}
+
+// Add one frame's pad state; returns 0 (and drops the frame) if the
+// buffer is full
+//
+int rec_frame(inputrec *rec, uint32_t pad)
+{
+   pad &= 0xFFFF;
+
+   if ((rec->run != 0) && ((pad != rec->pad) || (rec->run == REC_MAXRUN))) {
+      if (rec_flush(rec) == 0)
+         return(0);
+   }
+
+   rec->pad = pad;
+   rec->run++;
+   rec->frames++;
+   return(1);
+}
+
+// Finish the recording; returns 0 (and drops the last run) if the
+// buffer is full
+//
+int rec_end(inputrec *rec)
+{
+   if (rec_flush(rec) == 0) {     // no room for the last run
+      rec->frames -= rec->run;
+      rec->run = 0;
+      return(0);
+   }
+   return(1);
+}
+
+void play_start(inputplay *play, const uint8_t *buf, int len)
+{
+   play->buf = buf;
+   play->len = len;
+   play->pos = 0;
+   play->pad = 0;
+   play->run = 0;
+}
+
+// Get the next frame's pad state; returns 0 at the end of the recording
+//
+int play_frame(inputplay *play, uint32_t *pad)
+{
+const uint8_t *in;
+
+   if (play->run == 0) {
+      if ((play->pos + REC_RUNBYTES) > play->len)
+         return(0);
+
+      in = play->buf + play->pos;
+      play->pad = in[0] | (in[1] << 8);
+      play->run = in[2];
+      play->pos += REC_RUNBYTES;
+   }
+
+   play->run--;
+   *pad = play->pad;
+   return(1);
+}
@@ -0,0 +1,55 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Input recording and replay
+//
+// A recording is the joypad state handed to game_frame() on each frame,
+// stored as runs: 3 bytes per run (pad state low, high, # of frames 1-255).
+// The pad rarely changes from one frame to the next, so a game costs a
+// few bytes per second.
+//
+// A session starts with game_start(seed); when a game ends, the next one
+// starts at the beginning of the following frame (so that the finished
+// game is still in place if the recording ends there).  The final-state
+// checksum is game_checksum() after the last frame.
+//
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+#define REC_RUNBYTES     3
+#define REC_MAXRUN       255
+
+typedef struct inputrecs
+{
+   uint8_t  *buf;
+   int       size;      // bytes available in buf
+   int       len;       // bytes used
+   uint16_t  pad;       // pad state of the run in progress
+   int       run;       // (# of frames in it so far)
+   long      frames;    // frames recorded
+   uint32_t  seed;      // game_start() seed
+} inputrec;
+
+typedef struct inputplays
+{
+   const uint8_t *buf;
+   int       len;
+   int       pos;       // next run to read
+   uint16_t  pad;       // pad state of the current run
+   int       run;       // (# of frames left in it)
+} inputplay;
+
+void rec_start(inputrec *rec, uint8_t *buf, int size, uint32_t seed);
+int  rec_frame(inputrec *rec, uint32_t pad);
+int  rec_end(inputrec *rec);
+
+void play_start(inputplay *play, const uint8_t *buf, int len);
+int  play_frame(inputplay *play, uint32_t *pad);
+
+#endif
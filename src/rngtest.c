@@ -0,0 +1,194 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// rngtest - check the piece generator (rng_xxx and the 7-bag in game.c)
+//
+// usage:
+//   blox-rngtest
+//
+// Checks that:
+//   - the same seed always deals the same pieces, and other seeds don't
+//   - every bag holds each piece once (so there are never more than 12
+//     other pieces between two of the same one)
+//   - rng_range() stays in range, and is evenly spread (chi-square)
+//   - each bit of rng_next() is set half of the time
+//   - the first piece of a game is evenly spread over consecutive seeds
+//     (games are seeded from the frame counter)
+// and reports how fast numbers and pieces are generated.
+//
+// Exits with 1 if any check fails.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "game.h"
+#include "hosttest.h"
+
+#define SEQLEN           70000
+#define RANGESAMPLES     7000000
+#define BITSAMPLES       1000000
+#define SEEDSAMPLES      70000
+#define SPEEDCOUNT       50000000
+
+#define CHISQ_6DOF       22.46	// chi-square, 6 degrees of freedom, p = 0.001
+
+static gamestate game;
+
+static double chisq(const long *counts, int bins, long total)
+{
+double expect = (double)total / bins;
+double sum = 0;
+int i;
+
+   for (i = 0; i < bins; i++)
+      sum += ((counts[i] - expect) * (counts[i] - expect)) / expect;
+   return(sum);
+}
+
+// deal len pieces from a game started with seed
+//
+static void deal(uint32_t seed, uint8_t *seq, int len)
+{
+int i;
+
+   game_start(&game, seed);
+   seq[0] = game.piecenum;
+   for (i = 1; i < len; i++) {
+      nxtpiece(&game);
+      seq[i] = game.piecenum;
+   }
+}
+
+int main(int argc, char *argv[])
+{
+static uint8_t seq1[SEQLEN], seq2[SEQLEN];
+long counts[NUMPIECES];
+long bits[32];
+int last[NUMPIECES];
+int i, j, n, val, ok, maxgap;
+uint32_t r;
+double x2, start, elapsed;
+char msg[100];
+
+   // determinism
+   //
+   deal(12345, seq1, SEQLEN);
+   deal(12345, seq2, SEQLEN);
+   check(memcmp(seq1, seq2, SEQLEN) == 0, "same seed deals the same pieces");
+
+   deal(12346, seq2, SEQLEN);
+   check(memcmp(seq1, seq2, SEQLEN) != 0, "next seed deals different pieces");
+
+   // bags, and the gaps between pieces
+   //
+   ok = 1;
+   for (i = 0; i < SEQLEN; i += NUMPIECES) {
+      memset(counts, 0, sizeof(counts));
+      for (j = 0; j < NUMPIECES; j++)
+         counts[seq1[i + j]]++;
+      for (j = 0; j < NUMPIECES; j++)
+         if (counts[j] != 1)
+            ok = 0;
+   }
+   check(ok, "each bag of 7 holds every piece once");
+
+   maxgap = 0;
+   for (j = 0; j < NUMPIECES; j++)
+      last[j] = -1;
+   for (i = 0; i < SEQLEN; i++) {
+      if ((last[seq1[i]] >= 0) && ((i - last[seq1[i]]) > maxgap))
+         maxgap = i - last[seq1[i]];
+      last[seq1[i]] = i;
+   }
+   sprintf(msg, "longest wait for a piece is at most 13 (%d)", maxgap);
+   check(maxgap <= 13, msg);
+
+   // lookahead
+   //
+   game_start(&game, 999);
+   ok = 1;
+   for (i = 0; i < 1000; i++) {
+      val = game_peek(&game, 1);
+      for (j = 1; j < NEXTPIECES; j++)
+         seq2[j] = game_peek(&game, j + 1);
+      nxtpiece(&game);
+      if (game.piecenum != val)
+         ok = 0;
+      for (j = 1; j < NEXTPIECES; j++)
+         if (game_peek(&game, j) != seq2[j])
+            ok = 0;
+   }
+   check(ok, "game_peek() shows the pieces which come next");
+
+   // rng_range()
+   //
+   rng_seed(&game, 1);
+   ok = 1;
+   for (n = 1; n <= 65536; n = (n < 64) ? (n + 1) : (n * 2)) {
+      for (i = 0; i < 10000; i++) {
+         val = rng_range(&game, n);
+         if ((val < 0) || (val >= n))
+            ok = 0;
+      }
+   }
+   check(ok, "rng_range(n) is always 0 to n-1");
+
+   memset(counts, 0, sizeof(counts));
+   for (i = 0; i < RANGESAMPLES; i++)
+      counts[rng_range(&game, NUMPIECES)]++;
+   x2 = chisq(counts, NUMPIECES, RANGESAMPLES);
+   sprintf(msg, "rng_range(7) is evenly spread (chi-square %.2f < %.2f)", x2, CHISQ_6DOF);
+   check(x2 < CHISQ_6DOF, msg);
+
+   // bits
+   //
+   memset(bits, 0, sizeof(bits));
+   for (i = 0; i < BITSAMPLES; i++) {
+      r = rng_next(&game);
+      for (j = 0; j < 32; j++)
+         bits[j] += (r >> j) & 1;
+   }
+   ok = 1;
+   for (j = 0; j < 32; j++)     // within 5 standard deviations
+      if (fabs(bits[j] - (BITSAMPLES / 2.0)) > (5 * sqrt(BITSAMPLES / 4.0)))
+         ok = 0;
+   check(ok, "every bit of rng_next() is set half of the time");
+
+   // first piece over consecutive seeds
+   //
+   memset(counts, 0, sizeof(counts));
+   for (i = 0; i < SEEDSAMPLES; i++) {
+      game_start(&game, i);
+      counts[(int)game.piecenum]++;
+   }
+   x2 = chisq(counts, NUMPIECES, SEEDSAMPLES);
+   sprintf(msg, "first piece is evenly spread over seeds (chi-square %.2f < %.2f)", x2, CHISQ_6DOF);
+   check(x2 < CHISQ_6DOF, msg);
+
+   // speed
+   //
+   rng_seed(&game, 1);
+   r = 0;
+   start = now_sec();
+   for (i = 0; i < SPEEDCOUNT; i++)
+      r += rng_next(&game);
+   elapsed = now_sec() - start;
+   printf("\nrng_next():  %.0f million/sec  (%08X)\n", (SPEEDCOUNT / elapsed) / 1e6, r);
+
+   game_start(&game, 1);
+   val = 0;
+   start = now_sec();
+   for (i = 0; i < SPEEDCOUNT; i++) {
+      nxtpiece(&game);
+      val += game.piecenum;
+   }
+   elapsed = now_sec() - start;
+   printf("nxtpiece():  %.0f million/sec  (%d)\n", (SPEEDCOUNT / elapsed) / 1e6, val);
+
+   return(check_exit());
+}
@@ -0,0 +1,415 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Saved game and high-score table (see save.h)
+//
+
+#include <string.h>
+
+#include "save.h"
+
+#if NUMPIECES > 8
+#error pieces are saved in 3 bits
+#endif
+
+#if SCOREMAX >= (1 << 24)
+#error scores are saved in 24 bits
+#endif
+
+hiscore hiscores[SAVE_SCORES];
+int     numhiscores;
+
+// what backup memory holds (once save_init() has read it)
+//
+static uint8_t savearea[SAVE_AREASIZE];
+
+// a block is built here before it is compared with savearea[]
+//
+static uint8_t saveblock[SAVE_HDRSIZE + SAVE_GAMEMAX];
+
+typedef struct bitbufs
+{
+   uint8_t  *buf;
+   int       pos;       // in bits
+   int       len;       // (limit for reading, in bits)
+   int       over;      // a read went past len
+} bitbuf;
+
+
+// CRC-16/CCITT (polynomial 0x1021, starting at 0xFFFF); a bit at a time,
+// as it is only run on a save or a load
+//
+uint16_t save_crc16(const uint8_t *buf, int len)
+{
+uint16_t crc = 0xFFFF;
+int i;
+
+   while (len-- > 0) {
+      crc ^= (*buf++) << 8;
+      for (i = 0; i < 8; i++)
+         crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+   }
+   return(crc);
+}
+
+static void put_bits(bitbuf *bb, uint32_t val, int bits)
+{
+int i;
+
+   for (i = 0; i < bits; i++, bb->pos++) {
+      if (val & (1u << i))
+         bb->buf[bb->pos >> 3] |= (1 << (bb->pos & 7));
+   }
+}
+
+static uint32_t get_bits(bitbuf *bb, int bits)
+{
+uint32_t val = 0;
+int i;
+
+   if ((bb->pos + bits) > bb->len) {
+      bb->over = 1;
+      return(0);
+   }
+
+   for (i = 0; i < bits; i++, bb->pos++) {
+      if (bb->buf[bb->pos >> 3] & (1 << (bb->pos & 7)))
+         val |= (1u << i);
+   }
+   return(val);
+}
+
+// Write the changed part of a block: from the first byte which differs
+// from what is in backup memory to the last one.  Returns the # of bytes
+// written.
+//
+static int area_update(int addr, const uint8_t *data, int len)
+{
+int first, last;
+
+   for (first = 0; first < len; first++)
+      if (data[first] != savearea[addr + first])
+         break;
+
+   if (first == len)
+      return(0);
+
+   for (last = len - 1; data[last] == savearea[addr + last]; last--)
+      ;
+
+   memcpy(&savearea[addr + first], &data[first], last - first + 1);
+   bkup_write(addr + first, &savearea[addr + first], last - first + 1);
+
+   return(last - first + 1);
+}
+
+// Fill in the header of a block of len data bytes (in saveblock[]), and
+// write it
+//
+static int block_write(int addr, char magic, int len)
+{
+uint16_t crc;
+
+   saveblock[0] = 'B';
+   saveblock[1] = magic;
+   saveblock[4] = SAVE_VERSION;
+   saveblock[5] = len & 0xFF;
+   if (SAVE_LENBYTES > 1)
+      saveblock[6] = len >> 8;
+
+   crc = save_crc16(&saveblock[4], (SAVE_HDRSIZE - 4) + len);
+   saveblock[2] = crc & 0xFF;
+   saveblock[3] = crc >> 8;
+
+   return(area_update(addr, saveblock, SAVE_HDRSIZE + len));
+}
+
+// Check the block at addr; on SAVE_OK, *len is the # of data bytes
+// (which follow the header in savearea[])
+//
+static int block_check(int addr, char magic, int maxlen, int *len)
+{
+const uint8_t *hdr = &savearea[addr];
+int datalen;
+
+   if ((hdr[0] != 'B') || (hdr[1] != magic))
+      return(SAVE_NONE);
+
+   datalen = hdr[5];
+   if (SAVE_LENBYTES > 1)
+      datalen |= hdr[6] << 8;
+
+   if ((datalen > maxlen) ||
+       (save_crc16(&hdr[4], (SAVE_HDRSIZE - 4) + datalen) != (hdr[2] | (hdr[3] << 8))))
+      return(SAVE_BADCRC);
+
+   if (hdr[4] != SAVE_VERSION)
+      return(SAVE_BADVERSION);
+
+   *len = datalen;
+   return(SAVE_OK);
+}
+
+static void load_scores(void)
+{
+const uint8_t *p = &savearea[SAVE_SCOREOFF + SAVE_HDRSIZE];
+int i, len;
+
+   numhiscores = 0;
+
+   if (block_check(SAVE_SCOREOFF, 'S', SAVE_SCORES * SAVE_SCOREBYTES, &len) != SAVE_OK)
+      return;
+
+   for (i = 0; i < (len / SAVE_SCOREBYTES); i++, p += SAVE_SCOREBYTES) {
+      hiscores[i].score = p[0] | (p[1] << 8) | (p[2] << 16);
+      hiscores[i].level = p[3];
+
+      if ((hiscores[i].score > SCOREMAX) ||
+          ((i > 0) && (hiscores[i].score > hiscores[i - 1].score)))
+         break;                  // (not a table this version wrote)
+   }
+   numhiscores = i;
+}
+
+// Read the save area, and load the high-score table (which is left empty
+// if it isn't there or is damaged).  Returns the state of the saved game
+// (SAVE_OK if there is one to load).
+//
+int save_init(void)
+{
+int len;
+
+   bkup_read(0, savearea, SAVE_AREASIZE);
+
+   load_scores();
+
+   return(block_check(SAVE_GAMEOFF, 'G', SAVE_GAMEMAX, &len));
+}
+
+// Pack a game into buf (SAVE_GAMEMAX bytes); returns its length
+//
+int save_pack(const gamestate *gs, uint8_t *buf)
+{
+bitbuf bb = { buf, 0, 0, 0 };
+int i, j, top;
+
+   memset(buf, 0, SAVE_GAMEMAX);
+
+   put_bits(&bb, FIELDWIDTH, 8);
+   put_bits(&bb, FIELDHEIGHT + FIELDHIDHT, 8);
+   put_bits(&bb, gs->rngstate, 32);
+   put_bits(&bb, gs->scoreval, 24);
+   put_bits(&bb, gs->levelval, 8);
+   put_bits(&bb, gs->fpmcount, 8);
+   put_bits(&bb, gs->piecenum, 3);
+   put_bits(&bb, gs->phasenum, 2);
+   put_bits(&bb, gs->pieceposx, 8);
+   put_bits(&bb, gs->pieceposy, 8);
+   put_bits(&bb, gs->piecelow, 8);
+
+   put_bits(&bb, gs->bagleft, 3);
+   for (i = 0; i < NUMPIECES; i++)
+      put_bits(&bb, gs->bag[i], 3);
+   for (i = 0; i < NEXTPIECES; i++)
+      put_bits(&bb, game_peek(gs, i + 1), 3);
+
+   for (top = 0; top < (FIELDHEIGHT+FIELDHIDHT); top++)
+      if (gs->dispmask[top] != 0)
+         break;
+   put_bits(&bb, top, 8);
+
+   for (i = top; i < (FIELDHEIGHT+FIELDHIDHT); i++)
+      put_bits(&bb, gs->dispmask[i], FIELDWIDTH);
+
+   for (i = top; i < (FIELDHEIGHT+FIELDHIDHT); i++)
+      for (j = 0; j < FIELDWIDTH; j++)
+         if (gs->dispmask[i] & FIELDBIT(j))
+            put_bits(&bb, gs->displn[i][j] - 1, 3);
+
+   return((bb.pos + 7) >> 3);
+}
+
+// Suspend a game; returns the # of bytes written to backup memory
+//
+int save_game(const gamestate *gs)
+{
+   return(block_write(SAVE_GAMEOFF, 'G', save_pack(gs, &saveblock[SAVE_HDRSIZE])));
+}
+
+// Remove the saved game (the magic is enough)
+//
+int save_clear_game(void)
+{
+static const uint8_t nomagic[2] = { 0, 0 };
+
+   return(area_update(SAVE_GAMEOFF, nomagic, 2));
+}
+
+// Resume the saved game, into gs.  Everything is checked before any of
+// gs is touched, so on failure the game in progress (if any) is as it
+// was.  The pad's repeat state isn't saved: the game carries on as if no
+// buttons were held.  The difficulty table is gs's own (see game_start()),
+// so a gamestate which was never started (as at power-on) gets diff_level.
+//
+int load_game(gamestate *gs)
+{
+static fieldrow mask[(FIELDHEIGHT+FIELDHIDHT+FIELDFLOOR)];
+static char     colour[(FIELDHEIGHT+FIELDHIDHT)][FIELDWIDTH];
+uint8_t  newbag[NUMPIECES], newnext[NEXTPIECES];
+uint32_t rng;
+int score, level, count, type, phase, xpos, ypos, low, left;
+const piecemask *pm;
+bitbuf bb = { &savearea[SAVE_GAMEOFF + SAVE_HDRSIZE], 0, 0, 0 };
+int i, j, top, result;
+
+   result = block_check(SAVE_GAMEOFF, 'G', SAVE_GAMEMAX, &bb.len);
+   if (result != SAVE_OK)
+      return(result);
+
+   game_default_levels(gs);
+
+   bb.len *= 8;
+
+   if ((get_bits(&bb, 8) != FIELDWIDTH) || (get_bits(&bb, 8) != (FIELDHEIGHT + FIELDHIDHT)))
+      return(SAVE_BADVERSION);
+
+   rng   = get_bits(&bb, 32);
+   score = get_bits(&bb, 24);
+   level = get_bits(&bb, 8);
+   count = get_bits(&bb, 8);
+   type  = get_bits(&bb, 3);
+   phase = get_bits(&bb, 2);
+   xpos  = get_bits(&bb, 8);
+   ypos  = get_bits(&bb, 8);
+   low   = get_bits(&bb, 8);
+
+   left  = get_bits(&bb, 3);
+   for (i = 0; i < NUMPIECES; i++)
+      newbag[i] = get_bits(&bb, 3);
+   for (i = 0; i < NEXTPIECES; i++)
+      newnext[i] = get_bits(&bb, 3);
+
+   top = get_bits(&bb, 8);
+
+   if ((rng == 0) || (score > SCOREMAX) || (level >= gs->numlevels) ||
+       (count < 1) || (count > gs->difftbl[level].vsyncs) ||
+       (type >= NUMPIECES) || (low >= (FIELDHEIGHT+FIELDHIDHT)) || (left > NUMPIECES) ||
+       (top > (FIELDHEIGHT+FIELDHIDHT)))
+      return(SAVE_BADDATA);
+
+   for (i = 0; i < NUMPIECES; i++)
+      if (newbag[i] >= NUMPIECES)
+         return(SAVE_BADDATA);
+   for (i = 0; i < NEXTPIECES; i++)
+      if (newnext[i] >= NUMPIECES)
+         return(SAVE_BADDATA);
+
+   // the field: full rows would have been removed
+   //
+   memset(mask, 0, sizeof(mask));
+   memset(colour, 0, sizeof(colour));
+
+   for (i = top; i < (FIELDHEIGHT+FIELDHIDHT); i++) {
+      mask[i] = get_bits(&bb, FIELDWIDTH);
+      if (mask[i] == FIELDFULLMASK)
+         return(SAVE_BADDATA);
+   }
+   for (i = (FIELDHEIGHT + FIELDHIDHT); i < (FIELDHEIGHT + FIELDHIDHT + FIELDFLOOR); i++)
+      mask[i] = FIELDFULLMASK;
+
+   for (i = top; i < (FIELDHEIGHT+FIELDHIDHT); i++)
+      for (j = 0; j < FIELDWIDTH; j++)
+         if (mask[i] & FIELDBIT(j))
+            colour[i][j] = get_bits(&bb, 3) + 1;
+
+   if (bb.over || ((top < (FIELDHEIGHT+FIELDHIDHT)) && (mask[top] == 0)))
+      return(SAVE_BADDATA);
+
+   // the piece must be in a place it could have got to
+   //
+   pm = &piecemasktbl[PIECEIDX(type, phase)];
+   if ((xpos > (FIELDWIDTH - pm->width)) || ((ypos + pm->height) > (FIELDHEIGHT+FIELDHIDHT)))
+      return(SAVE_BADDATA);
+
+   for (i = 0; i < pm->height; i++)
+      if (mask[ypos + i] & ((fieldrow)pm->rowmask[i] << xpos))
+         return(SAVE_BADDATA);
+
+   // all good
+   //
+   clear_display_field(gs);
+   memcpy(gs->dispmask, mask, sizeof(gs->dispmask));
+   memcpy(gs->displn, colour, sizeof(gs->displn));
+
+   for (i = (FIELDHEIGHT+FIELDHIDHT - 1); i >= top; i--) {
+      for (j = 0; j < FIELDWIDTH; j++) {
+         if (mask[i] & FIELDBIT(j)) {
+            gs->rowfill[i]++;
+            gs->coltop[j] = i;
+         }
+      }
+   }
+
+   memset(gs->joyrptstate, 0, sizeof(gs->joyrptstate));
+   gs->joyout = 0;
+
+   gs->rngstate   = rng;
+   gs->scoreval   = score;
+   gs->levelval   = level;
+   gs->frampermov = gs->difftbl[gs->levelval].vsyncs;
+   gs->fpmcount   = count;
+
+   gs->piecenum  = type;
+   gs->phasenum  = phase;
+   gs->pieceposx = xpos;
+   gs->pieceposy = ypos;
+   gs->piecelow  = low;
+
+   gs->bagleft = left;
+   memcpy(gs->bag, newbag, sizeof(gs->bag));
+   memcpy(gs->nextq, newnext, sizeof(gs->nextq));
+   gs->nextpos = 0;
+
+   gs->ghostposy = landing_row(gs, gs->piecenum, gs->phasenum, gs->pieceposx, gs->pieceposy);
+
+   return(SAVE_OK);
+}
+
+// Put a finished game's score in the table, if it makes it (below any
+// equal scores already there); returns its place (from 0), or -1
+//
+int save_score(int score, int level)
+{
+uint8_t *p = &saveblock[SAVE_HDRSIZE];
+int i, place;
+
+   for (place = 0; place < numhiscores; place++)
+      if (score > hiscores[place].score)
+         break;
+
+   if ((score == 0) || (place == SAVE_SCORES))
+      return(-1);
+
+   if (numhiscores < SAVE_SCORES)
+      numhiscores++;
+
+   for (i = numhiscores - 1; i > place; i--)
+      hiscores[i] = hiscores[i - 1];
+
+   hiscores[place].score = score;
+   hiscores[place].level = level;
+
+   for (i = 0; i < numhiscores; i++, p += SAVE_SCOREBYTES) {
+      p[0] = hiscores[i].score & 0xFF;
+      p[1] = (hiscores[i].score >> 8) & 0xFF;
+      p[2] = hiscores[i].score >> 16;
+      p[3] = hiscores[i].level;
+   }
+
+   block_write(SAVE_SCOREOFF, 'S', numhiscores * SAVE_SCOREBYTES);
+
+   return(place);
+}
@@ -0,0 +1,93 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Saved game and high-score table, kept in backup memory
+//
+// The save area is SAVE_AREASIZE bytes of backup memory (a file of its
+// own there - see bkupfs.h), holding two blocks: the high-score table,
+// and a suspended game (written when the game is paused, and removed when
+// it ends).  Each block starts with a header:
+//   2 bytes   magic ("BS" for scores, "BG" for a game)
+//   2 bytes   CRC-16 (CCITT) of everything after it, LSB first
+//   1 byte    format version (SAVE_VERSION)
+//   1 byte    # of data bytes which follow (2 bytes, LSB first, if the
+//             field is wide enough for a game to need more than 255)
+// so a block which was never written, was half-written, or was written by
+// another version is seen as absent, and the other block is unaffected.
+//
+// A game is packed as a bit stream (LSB first): the field size, rngstate,
+// score, level, fall countdown, piece/phase/position (and the lowest row
+// it has reached), what is left in the bag, the next pieces, and then the
+// field - the first row holding anything, an occupancy mask for each row
+// from there down, and 3 bits of colour for each filled square.  A game
+// in progress is a few dozen bytes.
+//
+// The whole area is read into RAM once, by save_init().  From then on it
+// is a copy of what is in backup memory: each update is built in RAM,
+// compared with it, and only the span from the first to the last changed
+// byte is written, as one bkup_write() (or none, if nothing changed).
+//
+// Nothing here touches the hardware: the platform supplies bkup_read()
+// and bkup_write() (addr is from the start of the save area), so that the
+// host tools can use a file instead.
+//
+
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+#define SAVE_VERSION     2
+
+#define SAVE_LENBYTES    ((SAVE_GAMEMAX > 255) ? 2 : 1)
+#define SAVE_HDRSIZE     (5 + SAVE_LENBYTES)
+#define SAVE_SCORES      8	// entries in the high-score table
+#define SAVE_SCOREBYTES  4	// (each: score, 24 bits, and level)
+
+// the longest a packed game can be: SAVE_FIXEDBITS, then a mask for every
+// row and a colour for every square
+//
+#define SAVE_FIXEDBITS   (8 + 8 + 32 + 24 + 8 + 8 + 3 + 2 + 8 + 8 + 8 + 3 + (NUMPIECES * 3) + (NEXTPIECES * 3) + 8)
+#define SAVE_GAMEMAX     ((SAVE_FIXEDBITS + ((FIELDHEIGHT+FIELDHIDHT) * FIELDWIDTH * 4) + 7) / 8)
+
+#define SAVE_SCOREOFF    0
+#define SAVE_GAMEOFF     (SAVE_SCOREOFF + SAVE_HDRSIZE + (SAVE_SCORES * SAVE_SCOREBYTES))
+#define SAVE_AREASIZE    (SAVE_GAMEOFF + SAVE_HDRSIZE + SAVE_GAMEMAX)
+
+// results of save_init() and load_game()
+//
+#define SAVE_OK          0
+#define SAVE_NONE        1	// nothing saved
+#define SAVE_BADCRC      2	// damaged
+#define SAVE_BADVERSION  3	// saved by another version (or field size)
+#define SAVE_BADDATA     4	// intact, but not a possible game
+
+typedef struct hiscores
+{
+   int      score;
+   int      level;
+} hiscore;
+
+extern hiscore hiscores[SAVE_SCORES];    // best first
+extern int     numhiscores;
+
+// supplied by the platform: addr is from the start of the save area
+//
+void bkup_read(int addr, uint8_t *buf, int len);
+void bkup_write(int addr, const uint8_t *buf, int len);
+
+int      save_init(void);
+int      save_game(const gamestate *gs);
+int      load_game(gamestate *gs);
+int      save_clear_game(void);
+int      save_score(int score, int level);
+
+int      save_pack(const gamestate *gs, uint8_t *buf);
+uint16_t save_crc16(const uint8_t *buf, int len);
+
+#endif
@@ -0,0 +1,546 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// savetest - check the saved game and high-score table (save.c), and the
+// save file in backup memory which holds them (bkupfs.c)
+//
+// usage:
+//   blox-savetest [bkupfile]
+//
+// Backup memory is stood in for by a file (default blox-savetest.bkup,
+// which is overwritten).  Checks that:
+//   - a save file is made in freshly formatted backup memory, in the
+//     first free clusters which will hold it, and is found again without
+//     writing anything
+//   - making it changes nothing but its own directory entry, FAT chain
+//     and (cleared) data
+//   - unformatted or full backup memory, or a save file too small for the
+//     save area, is turned down without writing anything
+//   - an empty save area has no game and no scores
+//   - games saved at many points (random input, over many seeds) load
+//     back to the same state, and play on the same way from there
+//   - a saved game also loads into a gamestate which was never started
+//     (as blox.c's is at power-on)
+//   - saving a game which hasn't changed writes nothing, and each save or
+//     score is written as one burst
+//   - every single-bit error in either block is caught, and leaves the
+//     game in progress and the other block alone
+//   - another version's save, and an intact save of an impossible game,
+//     are turned down
+//   - the high-score table keeps the best scores in order, and survives
+//     a reload
+// and reports the size of the saved games.
+//
+// Exits with 1 if any check fails.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game.h"
+#include "bkupfs.h"
+#include "hosttest.h"
+#include "save.h"
+
+#define GAMES            200
+#define SAVEINTERVAL     37	// frames between saves in a game
+#define PLAYON           300	// frames played on after a load
+#define POWERONFRAMES    120	// frames played before the power-on save
+
+#define SAVEFILE         "BLOX    SAV"	// (as in blox.c)
+
+// the volume the BIOS formats backup memory as (see bkupfs.h): 256
+// 128-byte sectors - the boot sector, one FAT of 3, a root directory of
+// 16 (64 entries), and 236 clusters of one sector each
+//
+#define VOLCLUSSIZE      128
+#define VOLFAT           0x80
+#define VOLDIR           0x200
+#define VOLDATA          0xA00
+#define VOLCLUSTERS      236
+
+static const uint8_t bootsector[] = {
+   0x24, 0x8A, 0xDF, 'P', 'C', 'F', 'X', 'S', 'r', 'a', 'm',
+   0x80, 0x00, 0x01, 0x01, 0x00, 0x01, 0x40, 0x00, 0x00, 0x01, 0xF9, 0x03, 0x00
+};
+
+static const char *bkupname = "blox-savetest.bkup";
+
+static int  savebase;           // where the save file's data is
+
+static long rawwrites;          // bkupmem_write() calls
+static long writes;             // bkup_write() calls
+static long written;            // (bytes)
+
+static gamestate game;
+
+// the file-backed backup memory (for bkupfs.c)
+//
+void bkupmem_read(int addr, uint8_t *buf, int len)
+{
+FILE *f = fopen(bkupname, "rb");
+
+   if ((f == NULL) || (fseek(f, addr, SEEK_SET) != 0) || (fread(buf, 1, len, f) != (size_t)len)) {
+      fprintf(stderr, "blox-savetest: can't read %s\n", bkupname);
+      exit(1);
+   }
+   fclose(f);
+}
+
+void bkupmem_write(int addr, const uint8_t *buf, int len)
+{
+FILE *f = fopen(bkupname, "r+b");
+
+   if ((f == NULL) || (fseek(f, addr, SEEK_SET) != 0) || (fwrite(buf, 1, len, f) != (size_t)len)) {
+      fprintf(stderr, "blox-savetest: can't write %s\n", bkupname);
+      exit(1);
+   }
+   fclose(f);
+
+   rawwrites++;
+}
+
+// the save area, in the save file (for save.c)
+//
+void bkup_read(int addr, uint8_t *buf, int len)
+{
+   bkupmem_read(savebase + addr, buf, len);
+}
+
+void bkup_write(int addr, const uint8_t *buf, int len)
+{
+   bkupmem_write(savebase + addr, buf, len);
+
+   writes++;
+   written += len;
+}
+
+// all of backup memory set to val (0xFF is never written)
+//
+static void bkup_fill(int val)
+{
+FILE *f = fopen(bkupname, "wb");
+int i;
+
+   if (f == NULL) {
+      fprintf(stderr, "blox-savetest: can't create %s\n", bkupname);
+      exit(1);
+   }
+   for (i = 0; i < BKUPFS_MEMSIZE; i++)
+      fputc(val, f);
+   fclose(f);
+}
+
+// freshly formatted backup memory
+//
+static void bkup_format(void)
+{
+static const uint8_t fatstart[3] = { 0xF9, 0xFF, 0xFF };
+
+   bkup_fill(0);
+   bkupmem_write(0, bootsector, sizeof(bootsector));
+   bkupmem_write(VOLFAT, fatstart, sizeof(fatstart));
+}
+
+// freshly formatted backup memory, with a new save file in it
+//
+static void bkup_erase(void)
+{
+   bkup_format();
+
+   savebase = bkupfs_open(SAVEFILE, SAVE_AREASIZE);
+   if (savebase < 0) {
+      fprintf(stderr, "blox-savetest: can't make the save file (%d)\n", savebase);
+      exit(1);
+   }
+}
+
+// entry n of a FAT12 FAT
+//
+static int fat12_get(const uint8_t *fat, int n)
+{
+int val = fat[n + (n >> 1)] | (fat[n + (n >> 1) + 1] << 8);
+
+   return((n & 1) ? (val >> 4) : (val & 0xFFF));
+}
+
+// delete the file in root directory entry ent, as the BIOS does: the
+// entry marked free, and its clusters (first to first + count - 1) too
+//
+static void bkup_delete(int ent, int first, int count)
+{
+static const uint8_t deleted = 0xE5;
+uint8_t fat[3 * VOLCLUSSIZE];
+uint8_t *p;
+int n;
+
+   bkupmem_read(VOLFAT, fat, sizeof(fat));
+   for (n = first; n < (first + count); n++) {
+      p = &fat[n + (n >> 1)];
+      if (n & 1) {
+         p[0] &= 0x0F;
+         p[1] = 0;
+      }
+      else {
+         p[0] = 0;
+         p[1] &= 0xF0;
+      }
+   }
+   bkupmem_write(VOLFAT, fat, sizeof(fat));
+   bkupmem_write(VOLDIR + (ent * 32), &deleted, 1);
+}
+
+static int bkup_peek(int addr)
+{
+uint8_t val;
+
+   bkup_read(addr, &val, 1);
+   return(val);
+}
+
+static void bkup_poke(int addr, int val)
+{
+uint8_t byte = val;
+
+   bkup_write(addr, &byte, 1);
+}
+
+// the whole length (header and data) of the block at addr
+//
+static int block_len(int addr)
+{
+int len = bkup_peek(addr + 5);
+
+   if (SAVE_LENBYTES > 1)
+      len |= bkup_peek(addr + 6) << 8;
+   return(SAVE_HDRSIZE + len);
+}
+
+// random input, heavy on moves and drops, so that the field fills up
+// unevenly
+//
+static uint32_t random_pad(void)
+{
+static const uint32_t pads[8] = {
+   0, JOY_LEFT, JOY_RIGHT, JOY_DOWN, JOY_I, JOY_II, JOY_DOWN, JOY_LEFT | JOY_I
+};
+
+   lcgstate = (lcgstate * 1103515245) + 12345;
+   if (((lcgstate >> 16) % 40) == 0)
+      return(JOY_UP);
+   return(pads[(lcgstate >> 20) & 7]);
+}
+
+// play on from the current state; the checksum at the end
+//
+static uint32_t play_on(uint32_t seed, int frames)
+{
+int i;
+
+   lcgstate = seed;
+   for (i = 0; i < frames; i++)
+      if (game_frame(&game, random_pad()) & GAME_OVER)
+         break;
+   return(game_checksum(&game) ^ i);
+}
+
+int main(int argc, char *argv[])
+{
+static uint8_t  packed[SAVE_GAMEMAX];
+static fieldrow mask[(FIELDHEIGHT+FIELDHIDHT+FIELDFLOOR)];
+static uint8_t  fill[(FIELDHEIGHT+FIELDHIDHT)], top[FIELDWIDTH];
+static uint8_t  block[SAVE_HDRSIZE + SAVE_GAMEMAX];
+static uint8_t  image[BKUPFS_MEMSIZE], newimage[BKUPFS_MEMSIZE];
+hiscore scores[SAVE_SCORES];
+uint32_t sum, after;
+long saves = 0, bytes = 0, burst = 0, onewrite = 0, nochange = 0;
+int maxbytes = 0;
+int i, j, n, len, first, ok, sameok, playok, flipok, keepok, ghost, low;
+uint16_t crc;
+char msg[100];
+
+   if (argc > 2) {
+      fprintf(stderr, "Usage:\n    blox-savetest [bkupfile]\n");
+      return(1);
+   }
+   if (argc == 2)
+      bkupname = argv[1];
+
+   // the save file
+   //
+   bkup_format();
+   rawwrites = 0;
+   n = bkupfs_open(SAVEFILE, SAVE_AREASIZE);
+   ok = (n == VOLDATA) && (rawwrites > 0);
+   rawwrites = 0;
+   check(ok && (bkupfs_open(SAVEFILE, SAVE_AREASIZE) == n) && (rawwrites == 0),
+         "a save file is made, and found again");
+
+   // (in the space a deleted file left, between another file and the start)
+   //
+   len = (SAVE_AREASIZE + VOLCLUSSIZE - 1) / VOLCLUSSIZE;
+   bkup_format();
+   bkupfs_open("OTHER1  SAV", len * VOLCLUSSIZE);
+   n = bkupfs_open("OTHER2  DAT", 8 * VOLCLUSSIZE);
+   bkup_delete(0, 2, len);
+   memset(image, 0xA5, len * VOLCLUSSIZE);
+   bkupmem_write(VOLDATA, image, len * VOLCLUSSIZE);
+   memset(image, 0x5A, 8 * VOLCLUSSIZE);
+   bkupmem_write(n, image, 8 * VOLCLUSSIZE);
+
+   bkupmem_read(0, image, BKUPFS_MEMSIZE);
+   savebase = bkupfs_open(SAVEFILE, SAVE_AREASIZE);
+   bkupmem_read(0, newimage, BKUPFS_MEMSIZE);
+
+   check(savebase == VOLDATA, "a new save file goes in the first free clusters");
+
+   ok = (savebase >= VOLDATA);
+   if (ok) {
+      first = ((savebase - VOLDATA) / VOLCLUSSIZE) + 2;
+      for (i = first; i < (first + len); i++)
+         ok &= (fat12_get(&image[VOLFAT], i) == 0);
+      for (i = 0; i < BKUPFS_MEMSIZE; i++) {
+         if ((i >= savebase) && (i < (savebase + (len * VOLCLUSSIZE))))
+            ok &= (newimage[i] == 0);
+         else if ((i < VOLDIR) || (i >= (VOLDIR + 32)))
+            ok &= ((newimage[i] == image[i]) ||
+                   ((i >= (VOLFAT + first + (first >> 1))) &&
+                    (i <= (VOLFAT + (first + len - 1) + ((first + len - 1) >> 1) + 1))));
+      }
+      ok &= (memcmp(&newimage[VOLDIR], SAVEFILE, 11) == 0);
+   }
+   check(ok, "making it changes only its entry, FAT chain and data");
+   check(save_init() == SAVE_NONE, "a new save file has no saved game");
+
+   bkup_fill(0xFF);
+   rawwrites = 0;
+   n = bkupfs_open(SAVEFILE, SAVE_AREASIZE);
+   bkup_fill(0x00);
+   check((n == BKUPFS_NOFS) && (bkupfs_open(SAVEFILE, SAVE_AREASIZE) == BKUPFS_NOFS) &&
+         (rawwrites == 0), "unformatted backup memory is turned down, and left alone");
+
+   bkup_format();
+   bkupfs_open("FILLER  DAT", VOLCLUSTERS * VOLCLUSSIZE);
+   rawwrites = 0;
+   check((bkupfs_open(SAVEFILE, SAVE_AREASIZE) == BKUPFS_FULL) && (rawwrites == 0),
+         "full backup memory is turned down, and left alone");
+
+   bkup_format();
+   bkupfs_open(SAVEFILE, 1);
+   rawwrites = 0;
+   check((bkupfs_open(SAVEFILE, SAVE_AREASIZE) == BKUPFS_BADFILE) && (rawwrites == 0),
+         "a save file too small is turned down, and left alone");
+
+   // empty
+   //
+   bkup_erase();
+   check(save_init() == SAVE_NONE, "empty backup memory has no saved game");
+   check(numhiscores == 0, "empty backup memory has no high scores");
+   check(load_game(&game) == SAVE_NONE, "load_game() finds nothing to load");
+
+   // round trip
+   //
+   sameok = playok = ok = 1;
+
+   for (n = 0; n < GAMES; n++) {
+      game_start(&game, n + 1);
+      lcgstate = n + 1;
+
+      for (i = 1; ; i++) {
+         if (game_frame(&game, random_pad()) & GAME_OVER)
+            break;
+         if ((i % SAVEINTERVAL) != 0)
+            continue;
+
+         // (a resumed game starts with no buttons held)
+         //
+         memset(game.joyrptstate, 0, sizeof(game.joyrptstate));
+
+         writes  = 0;
+         written = 0;
+         len = save_pack(&game, packed);
+         bytes += len;
+         maxbytes = MAX(maxbytes, len);
+         saves++;
+
+         save_game(&game);
+         onewrite += (writes == 1);
+         burst    += written;
+
+         writes = 0;
+         save_game(&game);
+         nochange += (writes == 0);
+
+         sum   = game_checksum(&game);
+         ghost = game.ghostposy;
+         low   = game.piecelow;
+         memcpy(mask, game.dispmask, sizeof(mask));
+         memcpy(fill, game.rowfill, sizeof(fill));
+         memcpy(top, game.coltop, sizeof(top));
+
+         if ((saves % 10) == 0)
+            after = play_on(saves, PLAYON);
+
+         game_start(&game, ~n);      // (something else entirely)
+
+         if ((save_init() != SAVE_OK) || (load_game(&game) != SAVE_OK)) {
+            ok = 0;
+            break;
+         }
+
+         if ((game_checksum(&game) != sum) || (game.ghostposy != ghost) || (game.piecelow != low) ||
+             (memcmp(mask, game.dispmask, sizeof(mask)) != 0) ||
+             (memcmp(fill, game.rowfill, sizeof(fill)) != 0) ||
+             (memcmp(top, game.coltop, sizeof(top)) != 0))
+            sameok = 0;
+
+         if (((saves % 10) == 0) && (play_on(saves, PLAYON) != after))
+            playok = 0;
+
+         if ((saves % 10) == 0)      // (carry on from where it was)
+            load_game(&game);
+      }
+   }
+
+   sprintf(msg, "%ld saves load back", saves);
+   check(ok, msg);
+   check(sameok, "loaded games are in the same state as when saved");
+   check(playok, "loaded games play on the same way");
+   check(onewrite == saves, "each save is written in one burst");
+   check(nochange == saves, "saving an unchanged game writes nothing");
+
+   // power-on: nothing has been started (so there is no difficulty table
+   // yet) when the saved game is loaded.  The game is saved a few pieces
+   // in, well short of topping out on the narrowest field
+   //
+   game_start(&game, 99);
+   lcgstate = 99;
+   for (n = 0; n < POWERONFRAMES; n++)
+      if (game_frame(&game, random_pad()) & GAME_OVER)
+         break;
+   memset(game.joyrptstate, 0, sizeof(game.joyrptstate));
+   save_game(&game);
+   sum   = game_checksum(&game);
+   after = play_on(100, PLAYON);
+
+   memset(&game, 0, sizeof(game));
+   ok = ((save_init() == SAVE_OK) && (load_game(&game) == SAVE_OK));
+   check(ok && (n == POWERONFRAMES) && (game_checksum(&game) == sum) &&
+         (play_on(100, PLAYON) == after),
+         "a saved game loads into a never-started gamestate");
+
+   // corruption: every bit of the game block, then of the score block
+   //
+   bkup_erase();
+   save_init();
+   save_score(123, 4);
+   save_score(45, 2);
+   game_start(&game, 77);
+   play_on(77, 2000);
+   save_game(&game);
+   len = block_len(SAVE_GAMEOFF);
+   sum = game_checksum(&game);
+
+   flipok = keepok = 1;
+   for (i = 0; i < len; i++) {
+      for (j = 0; j < 8; j++) {
+         bkup_poke(SAVE_GAMEOFF + i, bkup_peek(SAVE_GAMEOFF + i) ^ (1 << j));
+
+         if ((save_init() == SAVE_OK) || (load_game(&game) == SAVE_OK))
+            flipok = 0;
+         if ((game_checksum(&game) != sum) || (numhiscores != 2))
+            keepok = 0;
+
+         bkup_poke(SAVE_GAMEOFF + i, bkup_peek(SAVE_GAMEOFF + i) ^ (1 << j));
+      }
+   }
+   sprintf(msg, "every bit error in the game block is caught (%d bits)", len * 8);
+   check(flipok, msg);
+   check(keepok, "... and the game in progress and scores are left alone");
+
+   len = block_len(SAVE_SCOREOFF);
+   flipok = keepok = 1;
+   for (i = 0; i < len; i++) {
+      for (j = 0; j < 8; j++) {
+         bkup_poke(SAVE_SCOREOFF + i, bkup_peek(SAVE_SCOREOFF + i) ^ (1 << j));
+
+         if (save_init() != SAVE_OK)
+            keepok = 0;
+         if (numhiscores != 0)
+            flipok = 0;
+
+         bkup_poke(SAVE_SCOREOFF + i, bkup_peek(SAVE_SCOREOFF + i) ^ (1 << j));
+      }
+   }
+   sprintf(msg, "every bit error in the score block is caught (%d bits)", len * 8);
+   check(flipok, msg);
+   check(keepok, "... and the saved game is left alone");
+
+   // intact, but not for this version / not a possible game
+   //
+   len = block_len(SAVE_GAMEOFF);
+   bkup_read(SAVE_GAMEOFF, block, len);
+
+   block[4] = SAVE_VERSION + 1;
+   crc = save_crc16(&block[4], len - 4);
+   block[2] = crc & 0xFF;
+   block[3] = crc >> 8;
+   bkup_write(SAVE_GAMEOFF, block, len);
+   check((save_init() == SAVE_BADVERSION) && (load_game(&game) == SAVE_BADVERSION),
+         "a save from another version is turned down");
+
+   block[4] = SAVE_VERSION;
+   block[SAVE_HDRSIZE + 2] = block[SAVE_HDRSIZE + 3] = 0;    // rngstate = 0
+   block[SAVE_HDRSIZE + 4] = block[SAVE_HDRSIZE + 5] = 0;
+   crc = save_crc16(&block[4], len - 4);
+   block[2] = crc & 0xFF;
+   block[3] = crc >> 8;
+   bkup_write(SAVE_GAMEOFF, block, len);
+   check((save_init() == SAVE_OK) && (load_game(&game) == SAVE_BADDATA) && (game_checksum(&game) == sum),
+         "an impossible game is turned down, and nothing is changed");
+
+   save_clear_game();
+   check((save_init() == SAVE_NONE) && (numhiscores == 2), "a cleared game is gone, and the scores are not");
+
+   // high scores
+   //
+   bkup_erase();
+   save_init();
+   ok = 1;
+   for (i = 0; i < 20; i++) {
+      writes = 0;
+      n = save_score((i * 37) % 101, i);
+      if ((n >= 0) && (writes != 1))
+         ok = 0;
+      if ((n < 0) && (writes != 0))
+         ok = 0;
+   }
+   for (i = 1; i < numhiscores; i++)
+      if (hiscores[i].score > hiscores[i - 1].score)
+         ok = 0;
+   check(ok && (numhiscores == SAVE_SCORES), "the table keeps the best scores, best first");
+
+   n = save_score(hiscores[0].score, 99);
+   check((n == 1) && (hiscores[1].level == 99), "an equal score goes below the one already there");
+   check(save_score(0, 0) < 0, "a score of 0 doesn't go in");
+   check(save_score(hiscores[SAVE_SCORES - 1].score, 0) < 0, "a score equal to the last place doesn't go in");
+
+   memcpy(scores, hiscores, sizeof(scores));
+   save_init();
+   check((numhiscores == SAVE_SCORES) && (memcmp(scores, hiscores, sizeof(scores)) == 0),
+         "the table reads back the same");
+
+   printf("\nsaved game: %.1f bytes on average, %d at most (room for %d)\n",
+          (double)bytes / saves, maxbytes, SAVE_GAMEMAX);
+   printf("            %.1f bytes written per save, on average (the span changed since the last one)\n",
+          (double)burst / saves);
+   printf("save area:  %d bytes\n", SAVE_AREASIZE);
+
+   remove(bkupname);
+
+   return(check_exit());
+}
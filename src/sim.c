@@ -0,0 +1,356 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// sim - play a large batch of games with the autoplayer, on all cores,
+//       to see how a difficulty table plays out
+//
+// usage:
+//   blox-sim [-g games] [-t threads] [-s seed] [-f maxframes] [-k] [tablefile]
+//
+// Each table is played for the given # of games (default 10000); game n
+// uses seed (seed + n), so results don't depend on the # of threads.
+// Games which last maxframes (default 216000 = 1 hour) are stopped there.
+// -k plays with wall kicks (ROT_KICKS, see game.h) instead of classic
+// rotation.
+//
+// tablefile has one difficulty table per line, as "vsyncs/score" pairs:
+//   30/4 24/9 20/14 16/19 12/29 10/39 8/49 6/59 5/69 4/79 3/99 2/119 1/99999
+// (blank lines and lines starting with '#' are skipped).  Without one,
+// the game's own diff_level[] is used.
+//
+// For each table, it reports games/second, and the distributions of
+// survival time and lines cleared.
+//
+// Threads share out the games with work-stealing: each starts with an
+// equal range of game numbers, and takes from the front of its own range;
+// a thread which runs out takes the back half of another thread's range.
+// A range is (next, end) packed into one 64-bit word, so both are done
+// with compare-and-swap.  Each thread plays its games in its own
+// gamestate.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "hosttest.h"
+#include "auto.h"
+
+#define SIMGAMES         10000
+#define SIMMAXFRAMES     216000
+#define MAXTHREADS       256
+#define MAXLEVELS        64
+#define MAXTABLES        64
+#define HISTBUCKETS      10
+
+#define RANGE(next, end)   (((uint64_t)(end) << 32) | (uint32_t)(next))
+#define RANGENEXT(range)   ((uint32_t)(range))
+#define RANGEEND(range)    ((uint32_t)((range) >> 32))
+
+typedef struct simtables
+{
+   chlng_level level[MAXLEVELS];
+   int         count;
+} simtable;
+
+typedef struct gameresults
+{
+   uint32_t    frames;
+   uint32_t    lines;
+} gameresult;
+
+typedef struct workers
+{
+   _Alignas(64) _Atomic uint64_t range;   // (each on its own cache line)
+   pthread_t   thread;
+   int         num;
+} worker;
+
+static worker     workers[MAXTHREADS];
+static int        numthreads;
+static simtable   tables[MAXTABLES];
+static int        numtables;
+static const simtable *curtable;
+static gameresult *results;
+static uint32_t   baseseed = 1;
+static long       maxframes = SIMMAXFRAMES;
+static int        rotmode = ROT_CLASSIC;
+
+static void play_game(gamestate *gs, uint32_t seed, gameresult *result)
+{
+autoplan plan;
+long frame;
+int events;
+
+   game_start(gs, seed);
+   auto_plan(gs, &plan);
+
+   for (frame = 1; frame < maxframes; frame++) {
+      events = game_frame(gs, auto_pad(gs, &plan));
+
+      if (events & GAME_OVER)
+         break;
+
+      if (events & GAME_LOCKED)
+         auto_plan(gs, &plan);
+   }
+
+   result->frames = frame;
+   result->lines  = gs->scoreval;
+}
+
+// take the next game from the front of our own range
+//
+static long take_game(worker *w)
+{
+uint64_t range;
+
+   range = atomic_load(&w->range);
+
+   while (RANGENEXT(range) < RANGEEND(range)) {
+      if (atomic_compare_exchange_weak(&w->range, &range, RANGE(RANGENEXT(range) + 1, RANGEEND(range))))
+         return(RANGENEXT(range));
+   }
+   return(-1);
+}
+
+// take the back half of somebody else's range; we get the first game of
+// it now, and the rest becomes our range
+//
+static long steal_game(worker *w)
+{
+uint64_t range;
+uint32_t next, end, mid;
+int i;
+worker *victim;
+
+   for (i = 1; i < numthreads; i++) {
+      victim = &workers[(w->num + i) % numthreads];
+      range  = atomic_load(&victim->range);
+
+      while (1) {
+         next = RANGENEXT(range);
+         end  = RANGEEND(range);
+         if (next >= end)
+            break;
+
+         mid = next + ((end - next) >> 1);
+
+         if (atomic_compare_exchange_weak(&victim->range, &range, RANGE(next, mid))) {
+            atomic_store(&w->range, RANGE(mid + 1, end));
+            return(mid);
+         }
+      }
+   }
+   return(-1);
+}
+
+static void *worker_main(void *arg)
+{
+worker *w = arg;
+gamestate gs;
+long game;
+
+   memset(&gs, 0, sizeof(gs));
+   game_set_levels(&gs, curtable->level, curtable->count);
+   game_set_rotation(&gs, rotmode);
+
+   while (1) {
+      game = take_game(w);
+      if (game < 0)
+         game = steal_game(w);
+      if (game < 0)
+         break;
+
+      play_game(&gs, baseseed + game, &results[game]);
+   }
+   return(NULL);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+uint32_t x = *(const uint32_t *)a;
+uint32_t y = *(const uint32_t *)b;
+
+   return((x > y) - (x < y));
+}
+
+// print mean, percentiles and a histogram of one result field
+//
+static void report(const char *name, uint32_t *vals, long count, double scale, const char *unit)
+{
+double sum = 0;
+long hist[HISTBUCKETS];
+uint32_t top, step;
+long i;
+int b;
+
+   qsort(vals, count, sizeof(uint32_t), cmp_u32);
+
+   for (i = 0; i < count; i++)
+      sum += vals[i];
+
+   printf("  %s (%s): mean %.1f  p10 %.1f  p50 %.1f  p90 %.1f  max %.1f\n", name, unit,
+          (sum / count) * scale, vals[count / 10] * scale, vals[count / 2] * scale,
+          vals[(count * 9) / 10] * scale, vals[count - 1] * scale);
+
+   top  = vals[count - 1] + 1;
+   step = (top + HISTBUCKETS - 1) / HISTBUCKETS;
+
+   memset(hist, 0, sizeof(hist));
+   for (i = 0; i < count; i++)
+      hist[vals[i] / step]++;
+
+   for (b = 0; b < HISTBUCKETS; b++)
+      printf("    %8.1f - %8.1f: %7.3f%%\n", (b * step) * scale, ((b + 1) * step) * scale,
+             (hist[b] * 100.0) / count);
+}
+
+static int read_tables(const char *filename)
+{
+FILE *infile;
+char line[1024];
+char *p;
+int vsyncs, score, used;
+simtable *t;
+
+   infile = fopen(filename, "r");
+   if (infile == NULL) {
+      fprintf(stderr, "blox-sim: cannot open %s\n", filename);
+      return(0);
+   }
+
+   while (fgets(line, sizeof(line), infile) != NULL) {
+      p = line + strspn(line, " \t");
+      if ((*p == '#') || (*p == '\n') || (*p == '\0'))
+         continue;
+
+      if (numtables == MAXTABLES) {
+         fprintf(stderr, "blox-sim: too many tables (max %d)\n", MAXTABLES);
+         break;
+      }
+
+      t = &tables[numtables];
+      t->count = 0;
+
+      while ((t->count < MAXLEVELS) && (sscanf(p, " %d/%d%n", &vsyncs, &score, &used) == 2)) {
+         if (vsyncs < 1) {
+            fprintf(stderr, "blox-sim: table %d: vsyncs must be at least 1\n", numtables + 1);
+            fclose(infile);
+            return(0);
+         }
+         t->level[t->count].vsyncs = vsyncs;
+         t->level[t->count].score  = score;
+         t->count++;
+         p += used;
+      }
+
+      if (t->count == 0) {
+         fprintf(stderr, "blox-sim: table %d: no levels\n", numtables + 1);
+         fclose(infile);
+         return(0);
+      }
+      numtables++;
+   }
+
+   fclose(infile);
+   return(numtables > 0);
+}
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage:\n    blox-sim [-g games] [-t threads] [-s seed] [-f maxframes] [-k] [tablefile]\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+long games = SIMGAMES;
+uint32_t *vals;
+double start, elapsed;
+long g;
+int i, t;
+
+   numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+   for (i = 1; i < argc; i++) {
+      if ((strcmp(argv[i], "-g") == 0) && (i + 1 < argc))
+         games = atol(argv[++i]);
+      else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc))
+         numthreads = atoi(argv[++i]);
+      else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc))
+         baseseed = strtoul(argv[++i], NULL, 0);
+      else if ((strcmp(argv[i], "-f") == 0) && (i + 1 < argc))
+         maxframes = atol(argv[++i]);
+      else if (strcmp(argv[i], "-k") == 0)
+         rotmode = ROT_KICKS;
+      else if ((argv[i][0] != '-') && (numtables == 0)) {
+         if (read_tables(argv[i]) == 0)
+            return(1);
+      }
+      else
+         usage();
+   }
+
+   if ((games < 1) || (games > 0x7FFFFFFF) || (maxframes < 1))
+      usage();
+   numthreads = MAX(1, MIN(numthreads, MAXTHREADS));
+
+   if (numtables == 0) {     // the game's own table
+      for (i = 0; i < diff_numlevels; i++)
+         tables[0].level[i] = diff_level[i];
+      tables[0].count = diff_numlevels;
+      numtables = 1;
+   }
+
+   results = malloc(games * sizeof(gameresult));
+   vals    = malloc(games * sizeof(uint32_t));
+   if ((results == NULL) || (vals == NULL)) {
+      fprintf(stderr, "blox-sim: out of memory\n");
+      return(1);
+   }
+
+   printf("%ld games per table, %d threads, seed %u\n", games, numthreads, baseseed);
+
+   for (t = 0; t < numtables; t++) {
+      curtable = &tables[t];
+
+      printf("\ntable %d:", t + 1);
+      for (i = 0; i < curtable->count; i++)
+         printf(" %d/%d", curtable->level[i].vsyncs, curtable->level[i].score);
+      printf("\n");
+
+      for (i = 0; i < numthreads; i++) {
+         workers[i].num = i;
+         atomic_store(&workers[i].range, RANGE((games * i) / numthreads, (games * (i + 1)) / numthreads));
+      }
+
+      start = now_sec();
+
+      for (i = 0; i < numthreads; i++)
+         pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+      for (i = 0; i < numthreads; i++)
+         pthread_join(workers[i].thread, NULL);
+
+      elapsed = now_sec() - start;
+
+      printf("  %.1f games/sec (%.2f sec)\n", games / elapsed, elapsed);
+
+      for (g = 0; g < games; g++)
+         vals[g] = results[g].frames;
+      report("survival", vals, games, 1.0 / 60, "seconds");
+
+      for (g = 0; g < games; g++)
+         vals[g] = results[g].lines;
+      report("lines", vals, games, 1.0, "lines");
+   }
+
+   return(0);
+}
@@ -0,0 +1,66 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Two-player versus (see versus.h)
+//
+
+#include "versus.h"
+
+// garbage sent for the # of lines cleared at once
+//
+static const uint8_t vsgarbage[5] = { 0, 0, 1, 2, 4 };
+
+// The difficulty table is kept from before (see game_start())
+//
+void versus_start(vsmatch *vs, uint32_t seed)
+{
+int i;
+
+   for (i = 0; i < VS_PLAYERS; i++) {
+      game_start(&vs->game[i], seed);
+      vs->pending[i] = 0;
+      vs->sent[i]    = 0;
+   }
+
+   vs->holestate = seed | 1;
+}
+
+static int hole_next(vsmatch *vs)
+{
+uint32_t x = vs->holestate;
+
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   vs->holestate = x;
+   return(((x >> 16) * FIELDWIDTH) >> 16);
+}
+
+// Run one player's game for a frame; returns the game_frame() result
+//
+int versus_frame(vsmatch *vs, int player, uint32_t pad)
+{
+gamestate *gs = &vs->game[player];
+int events, sent, cancel;
+
+   events = game_frame(gs, pad);
+
+   if (events & GAME_LINES) {
+      sent   = vsgarbage[MIN(gs->linescleared, 4)];
+      cancel = MIN(sent, vs->pending[player]);
+
+      vs->pending[player]     -= cancel;
+      vs->pending[player ^ 1] += sent - cancel;
+      vs->sent[player]        += sent - cancel;
+   }
+
+   if ((events & GAME_LOCKED) && !(events & GAME_OVER) && (vs->pending[player] != 0)) {
+      events |= game_garbage(gs, MIN(vs->pending[player], FIELDHEIGHT), hole_next(vs));
+      vs->pending[player] = 0;
+   }
+
+   return(events);
+}
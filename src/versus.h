@@ -0,0 +1,45 @@
+/*
+ *   Blox - A "falling blocks" type game for the PC-FX
+ *
+ *   Copyright (C) 2024 David Shadoff
+ */
+
+// Two-player versus
+//
+// Two games run side by side, from the same seed (so both players are
+// dealt the same pieces).  A match is a vsmatch: both gamestates, and the
+// garbage going between them.
+//
+// Clearing 2, 3 or 4 lines at once sends 1, 2 or 4 lines of garbage to
+// the other player; lines cleared first cancel out any garbage waiting
+// to come in.  Garbage comes in when the player's piece next comes to
+// rest, as rows pushed up from the bottom, with one hole (in the same
+// column for the whole batch).
+//
+// Platform interface: versus_start(vs, seed) at the beginning of a match,
+// and then versus_frame() for each player, each frame; each player's game
+// is drawn from vs->game[p].  The match is over once either game returns
+// GAME_OVER.
+//
+
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+#define VS_PLAYERS       2
+
+typedef struct vsmatches
+{
+   gamestate game[VS_PLAYERS];
+   int       pending[VS_PLAYERS];       // garbage waiting to come in
+   int       sent[VS_PLAYERS];          // lines sent, this match
+   uint32_t  holestate;                 // xorshift32, for the garbage hole
+} vsmatch;
+
+void versus_start(vsmatch *vs, uint32_t seed);
+int  versus_frame(vsmatch *vs, int player, uint32_t pad);
+
+#endif